@@ -18,5 +18,8 @@ namespace CharLS
         internal bool OutputBgr;
         private readonly JpegLSPresetCodingParameters custom;  // note: not used in this adapter interface.
         internal JfifParameters Jfif;
+        private readonly int restartInterval; // note: not used in this adapter interface.
+        private readonly int threadCount; // note: not used in this adapter interface.
+        private readonly int outputBufferSize; // note: not used in this adapter interface.
     }
 }
@@ -68,6 +68,278 @@ CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION JpegL
     const struct JlsParameters* params,
     const void* reserved);
 
+struct charls_jpegls_decoder;
+struct charls_jpegls_encoder;
+
+/// <summary>
+/// Receives a decoded row, in the same format as the row would have in a destination byte array. The row is only valid during the call.
+/// </summary>
+/// <param name="context">The context pointer that was passed with the line sink.</param>
+/// <param name="row">Index of the row in the image.</param>
+/// <param name="component">Index of the component plane when the components are not interleaved, otherwise 0 (the row holds all components).</param>
+/// <param name="pixels">The pixel data of the row.</param>
+/// <param name="size">Size of the row in bytes.</param>
+typedef void (CHARLS_API_CALLING_CONVENTION* charls_jpegls_line_sink)(void* context, int32_t row, int32_t component, const void* pixels, size_t size);
+
+/// <summary>
+/// Decodes a JPEG-LS encoded byte array and passes every row to a line sink as soon as it has been decoded, instead of writing it to a destination array.
+/// Only a few rows are kept in memory, independent of the size of the image.
+/// </summary>
+/// <param name="source">Byte array that holds the JPEG-LS encoded data that should be decoded.</param>
+/// <param name="sourceLength">Length of the array in bytes.</param>
+/// <param name="params">Parameter object that describes the pixel data and how to decode it, can be NULL.</param>
+/// <param name="lineSink">Function that receives the decoded rows, in the order of the rows of a destination array.</param>
+/// <param name="context">Pointer that is passed to the line sink.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_decode_to_line_sink(
+    const void* source,
+    size_t sourceLength,
+    const struct JlsParameters* params,
+    charls_jpegls_line_sink lineSink,
+    void* context);
+
+/// <summary>
+/// Creates a JPEG-LS decoder. The decoder keeps its codec, lookup tables and buffers between calls and reuses them
+/// for images that are encoded with the same parameters. Such calls don't allocate memory, unless they use more than one thread.
+/// Memory is allocated by the thread that makes the first call, a decoder per worker thread keeps the memory of each worker apart.
+/// </summary>
+/// <returns>The created decoder or NULL when there is not enough memory. Destroy it with charls_jpegls_decoder_destroy.</returns>
+CHARLS_API_IMPORT_EXPORT struct charls_jpegls_decoder* CHARLS_API_CALLING_CONVENTION charls_jpegls_decoder_create(void);
+
+/// <summary>
+/// Destroys a JPEG-LS decoder created with charls_jpegls_decoder_create.
+/// </summary>
+/// <param name="decoder">The decoder to destroy, can be NULL.</param>
+CHARLS_API_IMPORT_EXPORT void CHARLS_API_CALLING_CONVENTION charls_jpegls_decoder_destroy(const struct charls_jpegls_decoder* decoder);
+
+/// <summary>
+/// Decodes a JPEG-LS encoded byte array like JpegLsDecode, using the state the decoder kept from previous calls.
+/// A decoder can be used by one thread at a time.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_decoder_create.</param>
+/// <param name="destination">Byte array that holds the uncompressed pixel data bytes when the function returns.</param>
+/// <param name="destinationLength">Length of the array in bytes. If the array is too small the function will return an error.</param>
+/// <param name="source">Byte array that holds the JPEG-LS encoded data that should be decoded.</param>
+/// <param name="sourceLength">Length of the array in bytes.</param>
+/// <param name="params">Parameter object that describes the pixel data and how to decode it, can be NULL.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_decoder_decode(
+    struct charls_jpegls_decoder* decoder,
+    void* destination,
+    size_t destinationLength,
+    const void* source,
+    size_t sourceLength,
+    const struct JlsParameters* params);
+
+/// <summary>
+/// Decodes a JPEG-LS encoded file like charls_jpegls_decoder_decode. The file is mapped in memory with a sequential
+/// access hint: the decoder reads the pages of the file directly, it isn't read into a buffer first.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_decoder_create.</param>
+/// <param name="sourcePath">Path of the JPEG-LS encoded file, in the narrow character encoding of the platform.</param>
+/// <param name="destination">Byte array that holds the uncompressed pixel data bytes when the function returns.</param>
+/// <param name="destinationLength">Length of the array in bytes. If the array is too small the function will return an error.</param>
+/// <param name="params">Parameter object that describes the pixel data and how to decode it, can be NULL.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_decoder_decode_file(
+    struct charls_jpegls_decoder* decoder,
+    const char* sourcePath,
+    void* destination,
+    size_t destinationLength,
+    const struct JlsParameters* params);
+
+/// <summary>
+/// Decodes a JPEG-LS encoded file to a file with the uncompressed pixel data bytes, without padding between the rows.
+/// Both files are mapped in memory, the destination file is created (or replaced) with the size of the pixel data.
+/// When decoding fails after the destination file has been created, the destination file is removed.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_decoder_create.</param>
+/// <param name="sourcePath">Path of the JPEG-LS encoded file, in the narrow character encoding of the platform.</param>
+/// <param name="destinationPath">Path of the file that holds the uncompressed pixel data bytes when the function returns.</param>
+/// <param name="params">Parameter object that describes how to decode the pixel data, can be NULL. Its stride is not used.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_decoder_decode_file_to_file(
+    struct charls_jpegls_decoder* decoder,
+    const char* sourcePath,
+    const char* destinationPath,
+    const struct JlsParameters* params);
+
+/// <summary>
+/// Creates a JPEG-LS encoder. The encoder keeps its codec, lookup tables and buffers between calls and reuses them
+/// for images that are encoded with the same parameters. Such calls don't allocate memory, unless they use more than one thread.
+/// Memory is allocated by the thread that makes the first call, an encoder per worker thread keeps the memory of each worker apart.
+/// </summary>
+/// <returns>The created encoder or NULL when there is not enough memory. Destroy it with charls_jpegls_encoder_destroy.</returns>
+CHARLS_API_IMPORT_EXPORT struct charls_jpegls_encoder* CHARLS_API_CALLING_CONVENTION charls_jpegls_encoder_create(void);
+
+/// <summary>
+/// Destroys a JPEG-LS encoder created with charls_jpegls_encoder_create.
+/// </summary>
+/// <param name="encoder">The encoder to destroy, can be NULL.</param>
+CHARLS_API_IMPORT_EXPORT void CHARLS_API_CALLING_CONVENTION charls_jpegls_encoder_destroy(const struct charls_jpegls_encoder* encoder);
+
+/// <summary>
+/// Encodes a byte array with pixel data like JpegLsEncode, using the state the encoder kept from previous calls.
+/// An encoder can be used by one thread at a time.
+/// </summary>
+/// <param name="encoder">The encoder created with charls_jpegls_encoder_create.</param>
+/// <param name="destination">Byte array that holds the encoded bytes when the function returns.</param>
+/// <param name="destinationLength">Length of the array in bytes. If the array is too small the function will return an error.</param>
+/// <param name="bytesWritten">This parameter will hold the number of bytes written to the destination byte array. Cannot be NULL.</param>
+/// <param name="source">Byte array that holds the pixels that should be encoded.</param>
+/// <param name="sourceLength">Length of the array in bytes.</param>
+/// <param name="params">Parameter object that describes the pixel data and how to encode it.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_encoder_encode(
+    struct charls_jpegls_encoder* encoder,
+    void* destination,
+    size_t destinationLength,
+    size_t* bytesWritten,
+    const void* source,
+    size_t sourceLength,
+    const struct JlsParameters* params);
+
+/// <summary>
+/// Encodes a file with pixel data like charls_jpegls_encoder_encode. The source file is mapped in memory with a sequential
+/// access hint, the encoded bytes are written to the destination file, which is created or replaced.
+/// When encoding fails after the destination file has been created, the destination file is removed.
+/// </summary>
+/// <param name="encoder">The encoder created with charls_jpegls_encoder_create.</param>
+/// <param name="sourcePath">Path of the file with the pixels that should be encoded, in the narrow character encoding of the platform.</param>
+/// <param name="destinationPath">Path of the file that holds the encoded bytes when the function returns.</param>
+/// <param name="params">Parameter object that describes the pixel data and how to encode it.</param>
+/// <param name="bytesWritten">This parameter will hold the number of bytes written to the destination file. Cannot be NULL.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_encoder_encode_file(
+    struct charls_jpegls_encoder* encoder,
+    const char* sourcePath,
+    const char* destinationPath,
+    const struct JlsParameters* params,
+    size_t* bytesWritten);
+
+/// <summary>
+/// Supplies a row of pixels to encode, in the same format as the row would have in a source byte array.
+/// </summary>
+/// <param name="context">The context pointer that was passed with the row source.</param>
+/// <param name="row">Index of the row in the image.</param>
+/// <param name="component">Index of the component plane when the components are not interleaved, otherwise 0 (the row holds all components).</param>
+/// <param name="pixels">Buffer that receives the pixel data of the row.</param>
+/// <param name="size">Size of the row in bytes.</param>
+/// <returns>0 when the row has been supplied, any other value stops the encoding (the encode function returns source_buffer_too_small).</returns>
+typedef int32_t (CHARLS_API_CALLING_CONVENTION* charls_jpegls_row_source)(void* context, int32_t row, int32_t component, void* pixels, size_t size);
+
+/// <summary>
+/// Receives the next part of the encoded bytes. The bytes are only valid during the call.
+/// </summary>
+/// <param name="context">The context pointer that was passed with the byte sink.</param>
+/// <param name="bytes">The encoded bytes.</param>
+/// <param name="size">Number of bytes.</param>
+/// <returns>0 when the bytes have been processed, any other value stops the encoding (the encode function returns destination_buffer_too_small).</returns>
+typedef int32_t (CHARLS_API_CALLING_CONVENTION* charls_jpegls_byte_sink)(void* context, const void* bytes, size_t size);
+
+/// <summary>
+/// Encodes an image of which the rows are requested from a row source one at a time, when the encoder needs them,
+/// and passes the encoded bytes to a byte sink as they are produced. Images larger than the available memory can
+/// be encoded this way: the encoder only keeps a few rows and a small output buffer in memory.
+/// </summary>
+/// <param name="encoder">The encoder created with charls_jpegls_encoder_create.</param>
+/// <param name="rowSource">Function that supplies the rows, in the order of the rows of a source byte array.</param>
+/// <param name="byteSink">Function that receives the encoded bytes.</param>
+/// <param name="context">Pointer that is passed to the row source and the byte sink.</param>
+/// <param name="params">Parameter object that describes the pixel data and how to encode it.</param>
+/// <param name="bytesWritten">This parameter will hold the number of bytes passed to the byte sink. Cannot be NULL.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_encoder_encode_rows(
+    struct charls_jpegls_encoder* encoder,
+    charls_jpegls_row_source rowSource,
+    charls_jpegls_byte_sink byteSink,
+    void* context,
+    const struct JlsParameters* params,
+    size_t* bytesWritten);
+
+/// <summary>
+/// Decodes a batch of independent JPEG-LS encoded images concurrently, every decoder is used by one worker thread.
+/// Images are handed out one at a time to the worker that is done first, which keeps all workers busy when the images differ in size.
+/// Every worker reuses the codec of its decoder for the images it decodes; passing the same decoders to the next batch keeps these codecs.
+/// </summary>
+/// <param name="decoders">Decoders created with charls_jpegls_decoder_create, one per worker, or NULL to use temporary decoders.</param>
+/// <param name="decoderCount">Number of decoders and worker threads (the calling thread included). When decoders is NULL, 0 uses the number of hardware threads.</param>
+/// <param name="items">Array that describes the source and destination of every image.</param>
+/// <param name="count">Number of items.</param>
+/// <param name="results">Array of count elements that holds the result of every image when the function returns.</param>
+/// <returns>Success when all images are decoded, otherwise the result of the first image (in array order) that failed.</returns>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_decode_batch(
+    struct charls_jpegls_decoder* const* decoders,
+    int32_t decoderCount,
+    const struct JlsDecodeBatchItem* items,
+    size_t count,
+    CharlsApiResultType* results);
+
+struct charls_jpegls_push_decoder;
+
+/// <summary>
+/// Creates a JPEG-LS push decoder, which decodes encoded data that is received in parts while it arrives.
+/// Every call decodes as far as the received data allows and returns without waiting for more data,
+/// which makes it possible to decode many transfers on a few threads.
+/// </summary>
+/// <returns>The created decoder or NULL when there is not enough memory. Destroy it with charls_jpegls_push_decoder_destroy.</returns>
+CHARLS_API_IMPORT_EXPORT struct charls_jpegls_push_decoder* CHARLS_API_CALLING_CONVENTION charls_jpegls_push_decoder_create(void);
+
+/// <summary>
+/// Destroys a JPEG-LS push decoder created with charls_jpegls_push_decoder_create.
+/// </summary>
+/// <param name="decoder">The decoder to destroy, can be NULL.</param>
+CHARLS_API_IMPORT_EXPORT void CHARLS_API_CALLING_CONVENTION charls_jpegls_push_decoder_destroy(const struct charls_jpegls_push_decoder* decoder);
+
+/// <summary>
+/// Adds the next part of the JPEG-LS encoded data and decodes the lines that can be decoded with the data received so far.
+/// Lines are only decoded after the destination has been set. After an error the decoder keeps returning that error.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_push_decoder_create.</param>
+/// <param name="source">Byte array that holds the next part of the encoded data, the decoder copies the bytes it still needs.</param>
+/// <param name="sourceLength">Length of the array in bytes.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_push_decoder_feed(
+    struct charls_jpegls_push_decoder* decoder,
+    const void* source,
+    size_t sourceLength);
+
+/// <summary>
+/// Retrieves the JPEG-LS header, once the part of the encoded data that contains it has been received.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_push_decoder_create.</param>
+/// <param name="params">Parameter object that describes how the pixel data is encoded.</param>
+/// <returns>source_buffer_too_small when the header has not been received yet.</returns>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_push_decoder_read_header(
+    struct charls_jpegls_push_decoder* decoder,
+    struct JlsParameters* params);
+
+/// <summary>
+/// Sets the destination of the decoded pixels and decodes the lines that can be decoded with the data received so far.
+/// The destination can be set before or after the header has been received and must stay valid until all lines have been decoded.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_push_decoder_create.</param>
+/// <param name="destination">Byte array that holds the uncompressed pixel data bytes as they are decoded.</param>
+/// <param name="destinationLength">Length of the array in bytes. If the array is too small the function (or a next call) will return an error.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_push_decoder_set_destination(
+    struct charls_jpegls_push_decoder* decoder,
+    void* destination,
+    size_t destinationLength);
+
+/// <summary>
+/// Passes the decoded rows to a line sink instead of writing them to a destination, see charls_jpegls_decode_to_line_sink.
+/// The line sink replaces the destination and must be set before the first line is decoded.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_push_decoder_create.</param>
+/// <param name="lineSink">Function that receives the decoded rows.</param>
+/// <param name="context">Pointer that is passed to the line sink.</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_push_decoder_set_line_sink(
+    struct charls_jpegls_push_decoder* decoder,
+    charls_jpegls_line_sink lineSink,
+    void* context);
+
+/// <summary>
+/// Retrieves the number of lines that have been decoded into the destination. The lines are decoded in the order of the
+/// destination rows: when the components are not interleaved, the lines of every component plane follow each other.
+/// </summary>
+/// <param name="decoder">The decoder created with charls_jpegls_push_decoder_create.</param>
+/// <param name="lineCount">Receives the number of decoded lines, the image is complete at height (times the component count for non interleaved images).</param>
+CHARLS_API_IMPORT_EXPORT CharlsApiResultType CHARLS_API_CALLING_CONVENTION charls_jpegls_push_decoder_get_line_count(
+    const struct charls_jpegls_push_decoder* decoder,
+    size_t* lineCount);
+
 #ifdef __cplusplus
 }
 
@@ -5,6 +5,8 @@
 #include <vector>
 #include <cstddef>
 #include <filesystem>
+#include <memory>
+#include <new>
 
 // WARNING: THESE CLASSES ARE NOT FINAL AND THEIR DESIGN AND API MAY CHANGE
 
@@ -24,6 +26,14 @@ struct metadata_info_t
 class jpegls_decoder final
 {
 public:
+    // The decoder keeps its codec, lookup tables and buffers between calls to decode, for images with the same parameters.
+    jpegls_decoder() :
+        decoder_{charls_jpegls_decoder_create()}
+    {
+        if (!decoder_)
+            throw std::bad_alloc();
+    }
+
     void read_header(const void* source, const size_t source_size_bytes)
     {
         std::error_code ec;
@@ -43,6 +53,11 @@ public:
         metadata_ = { params_.width, params_.height, params_.bitsPerSample, params_.components };
     }
 
+    void thread_count(int value) noexcept
+    {
+        thread_count_ = value;
+    }
+
     const metadata_info_t& metadata_info() const noexcept
     {
         return metadata_;
@@ -58,7 +73,32 @@ public:
 
     void decode(void* destination, const size_t destination_size_bytes, std::error_code& error) const noexcept
     {
-        error = JpegLsDecode(destination, destination_size_bytes, source_, source_size_bytes_, &params_, nullptr);
+        JlsParameters parameters{params_};
+        parameters.threadCount = thread_count_;
+
+        error = charls_jpegls_decoder_decode(decoder_.get(), destination, destination_size_bytes, source_, source_size_bytes_, &parameters);
+    }
+
+    // Decodes a JPEG-LS file, the file is mapped in memory instead of read into a buffer.
+    void decode_file(const std::filesystem::path& source, void* destination, const size_t destination_size_bytes) const
+    {
+        JlsParameters parameters{};
+        parameters.threadCount = thread_count_;
+
+        const std::error_code error = charls_jpegls_decoder_decode_file(decoder_.get(), source.string().c_str(), destination, destination_size_bytes, &parameters);
+        if (error)
+            throw jpegls_error(error);
+    }
+
+    // Decodes a JPEG-LS file to a file with the pixels, without padding between the rows. Both files are mapped in memory.
+    void decode_file(const std::filesystem::path& source, const std::filesystem::path& destination) const
+    {
+        JlsParameters parameters{};
+        parameters.threadCount = thread_count_;
+
+        const std::error_code error = charls_jpegls_decoder_decode_file_to_file(decoder_.get(), source.string().c_str(), destination.string().c_str(), &parameters);
+        if (error)
+            throw jpegls_error(error);
     }
 
     size_t required_size() const noexcept
@@ -67,9 +107,21 @@ public:
     }
 
 private:
+    struct decoder_deleter final
+    {
+        void operator()(const charls_jpegls_decoder* decoder) const noexcept
+        {
+            charls_jpegls_decoder_destroy(decoder);
+        }
+    };
+
+    // The session only caches the codec between calls, which is not observable state: decode is const.
+    // A decoder object should still not be used by more than one thread at the same time.
+    mutable std::unique_ptr<charls_jpegls_decoder, decoder_deleter> decoder_;
     const void* source_{};
     size_t source_size_bytes_{};
     JlsParameters params_{};
+    int thread_count_{};
     metadata_info_t metadata_{};
 };
 
@@ -4,6 +4,9 @@
 
 #include <vector>
 #include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <new>
 
 // WARNING: THESE CLASSES ARE NOT FINAL AND THEIR DESIGN AND API MAY CHANGE
 
@@ -22,6 +25,14 @@ struct metadata
 class jpegls_encoder final
 {
 public:
+    // The encoder keeps its codec, lookup tables and buffers between calls to encode, for images with the same parameters.
+    jpegls_encoder() :
+        encoder_{charls_jpegls_encoder_create()}
+    {
+        if (!encoder_)
+            throw std::bad_alloc();
+    }
+
     void source(const void* source, size_t source_size_bytes, const metadata& metadata) noexcept
     {
         source_ = source,
@@ -39,6 +50,22 @@ public:
         allowed_lossy_error_ = value;
     }
 
+    void restart_interval(int value) noexcept
+    {
+        restart_interval_ = value;
+    }
+
+    void thread_count(int value) noexcept
+    {
+        thread_count_ = value;
+    }
+
+    // Sets the size of the buffer that collects the encoded data before it is written to a file or byte sink, 0 selects 1 MiB.
+    void output_buffer_size(int value) noexcept
+    {
+        output_buffer_size_ = value;
+    }
+
     std::vector<std::byte> encode()
     {
         // Assume that compressed pixels are smaller or equal to uncompressed pixels and reserve some room for JPEG header.
@@ -73,15 +100,100 @@ public:
             allowed_lossy_error_,
             interleave_mode_
         };
+        parameters.restartInterval = restart_interval_;
+        parameters.threadCount = thread_count_;
+
+        error = charls_jpegls_encoder_encode(encoder_.get(), destination, destination_size_bytes, &bytes_written,
+                                             source_, source_size_bytes_, &parameters);
+        return bytes_written;
+    }
+
+    // Encodes a file with pixels to a JPEG-LS file, the source file is mapped in memory instead of read into a buffer.
+    size_t encode_file(const std::filesystem::path& source, const std::filesystem::path& destination, const metadata& metadata)
+    {
+        JlsParameters parameters
+        {
+            metadata.width,
+            metadata.height,
+            metadata.bits_per_sample,
+            0,
+            metadata.component_count,
+            allowed_lossy_error_,
+            interleave_mode_
+        };
+        parameters.restartInterval = restart_interval_;
+        parameters.threadCount = thread_count_;
+        parameters.outputBufferSize = output_buffer_size_;
+
+        size_t bytes_written;
+        const std::error_code error = charls_jpegls_encoder_encode_file(encoder_.get(), source.string().c_str(), destination.string().c_str(),
+                                                                        &parameters, &bytes_written);
+        if (error)
+            throw jpegls_error(error);
+
+        return bytes_written;
+    }
+
+    // Encodes an image of which the rows are requested when the encoder needs them, the encoded bytes are passed on as they are produced.
+    // row_source(int32_t row, int32_t component, std::byte* pixels, size_t size) fills a row and returns false to stop.
+    // byte_sink(const std::byte* bytes, size_t size) receives the encoded bytes and returns false to stop.
+    template<typename RowSource, typename ByteSink>
+    size_t encode(const metadata& metadata, RowSource&& row_source, ByteSink&& byte_sink)
+    {
+        struct callbacks final
+        {
+            RowSource& row_source;
+            ByteSink& byte_sink;
+
+            static int32_t CHARLS_API_CALLING_CONVENTION read_row(void* context, int32_t row, int32_t component, void* pixels, size_t size)
+            {
+                return static_cast<callbacks*>(context)->row_source(row, component, static_cast<std::byte*>(pixels), size) ? 0 : 1;
+            }
+
+            static int32_t CHARLS_API_CALLING_CONVENTION write_bytes(void* context, const void* bytes, size_t size)
+            {
+                return static_cast<callbacks*>(context)->byte_sink(static_cast<const std::byte*>(bytes), size) ? 0 : 1;
+            }
+        };
+
+        JlsParameters parameters
+        {
+            metadata.width,
+            metadata.height,
+            metadata.bits_per_sample,
+            0,
+            metadata.component_count,
+            allowed_lossy_error_,
+            interleave_mode_
+        };
+        parameters.restartInterval = restart_interval_;
+        parameters.outputBufferSize = output_buffer_size_;
+
+        callbacks context{row_source, byte_sink};
+        size_t bytes_written;
+        const std::error_code error = charls_jpegls_encoder_encode_rows(encoder_.get(), callbacks::read_row, callbacks::write_bytes,
+                                                                        &context, &parameters, &bytes_written);
+        if (error)
+            throw jpegls_error(error);
 
-        error = JpegLsEncode(destination, destination_size_bytes, &bytes_written,
-                             source_, source_size_bytes_, &parameters, nullptr);
         return bytes_written;
     }
 
 private:
+    struct encoder_deleter final
+    {
+        void operator()(const charls_jpegls_encoder* encoder) const noexcept
+        {
+            charls_jpegls_encoder_destroy(encoder);
+        }
+    };
+
+    std::unique_ptr<charls_jpegls_encoder, encoder_deleter> encoder_;
     InterleaveMode interleave_mode_{InterleaveMode::None};
     int allowed_lossy_error_{};
+    int restart_interval_{};
+    int thread_count_{};
+    int output_buffer_size_{};
 
     const void* source_{};
     size_t source_size_bytes_{};
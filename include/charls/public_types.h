@@ -47,6 +47,7 @@ namespace charls
         unexpected_end_of_image_marker = 21,     // This error is returned when the stream contains an unexpected EOI marker.
         invalid_jpegls_preset_parameter_type = 22, // This error is returned when the stream contains an invalid type parameter in the JPEG-LS segment.
         jpegls_preset_extended_parameter_type_not_supported = 23, // This error is returned when the stream contains an unsupported type parameter in the JPEG-LS segment.
+        restart_marker_not_found = 24,           // This error is returned when the expected restart marker (RSTm) is not found at the end of a restart interval, or a RSTm marker is found outside a scan.
         invalid_argument_width = 100,            // The argument for the width parameter is outside the range [1, 65535].
         invalid_argument_height = 101,           // The argument for the height parameter is outside the range [1, 65535].
         invalid_argument_component_count = 102,  // The argument for the component count parameter is outside the range [1, 255].
@@ -153,6 +154,7 @@ using CharlsColorTransformationType = charls::ColorTransformation;
 #else
 
 #include <stdint.h>
+#include <stddef.h>
 
 // This API return code table is a copy of the C++ table. For additional info see the C++ table.
 // 2 tables are defined to prevent global namespace pollution.
@@ -181,6 +183,7 @@ enum CharlsApiResult
     CHARLS_API_RESULT_UNEXPECTED_END_OF_IMAGE_MARKER        = 20,
     CHARLS_API_RESULT_INVALID_JPEGLS_PRESET_PARAMETER_TYPE  = 21,
     CHARLS_API_RESULT_JPEGLS_PRESET_EXTENDED_PARAMETER_TYPE_NOT_SUPPORTED = 22,
+    CHARLS_API_RESULT_RESTART_MARKER_NOT_FOUND              = 24,
     CHARLS_API_RESULT_INVALID_ARGUMENT_WIDTH                = 100,
     CHARLS_API_RESULT_INVALID_ARGUMENT_HEIGHT               = 101,
     CHARLS_API_RESULT_INVALID_ARGUMENT_COMPONENT_COUNT      = 102,
@@ -263,6 +266,25 @@ struct JlsRect
 };
 
 
+/// <summary>
+/// Describes one image of a batch decoded with charls_jpegls_decode_batch.
+/// </summary>
+struct JlsDecodeBatchItem
+{
+    /// <summary>Byte array that holds the JPEG-LS encoded data of the image.</summary>
+    const void* source;
+
+    /// <summary>Length of the source array in bytes.</summary>
+    size_t sourceLength;
+
+    /// <summary>Byte array that holds the uncompressed pixel data bytes when the batch is decoded.</summary>
+    void* destination;
+
+    /// <summary>Length of the destination array in bytes.</summary>
+    size_t destinationLength;
+};
+
+
 /// <summary>
 /// Defines the parameters for the JPEG File Interchange Format.
 /// The format is defined in the JPEG File Interchange Format v1.02 document by Eric Hamilton.
@@ -373,6 +395,28 @@ struct JlsParameters
 
     struct JpegLSPresetCodingParameters custom;
     struct JfifParameters jfif;
+
+    /// <summary>
+    /// The number of lines in a restart interval. 0 (the default) means no restart markers are used.
+    /// When encoding, a non zero value writes a DRI segment and ends every interval with a RSTm marker.
+    /// When reading the header, this field is set to the value of the DRI segment (if present).
+    /// </summary>
+    int32_t restartInterval;
+
+    /// <summary>
+    /// The maximum number of threads (including the calling thread) the codec may use. 0 or 1 (the default) means
+    /// all work is done on the calling thread. When decoding to a buffer, the scans of an image (one per component when the
+    /// interleave mode is None) and the restart intervals of a scan are decoded concurrently. When encoding from and to a
+    /// buffer, these are encoded concurrently and concatenated in order: use restart intervals to split a single scan into bands.
+    /// </summary>
+    int32_t threadCount;
+
+    /// <summary>
+    /// The size in bytes of the buffer in which the encoder collects the encoded data before it is written to a destination
+    /// stream. 0 (the default) selects 1 MiB, the buffer is not larger than needed for the image. Not used when the
+    /// destination is a buffer.
+    /// </summary>
+    int32_t outputBufferSize;
 };
 
 
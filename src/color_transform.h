@@ -10,6 +10,15 @@ namespace charls
 // This file defines simple classes that define (lossless) color transforms.
 // They are invoked in process_line.h to convert between decoded values and the internal line buffers.
 // Color transforms work best for computer generated images, but are outside the official JPEG-LS specifications.
+// All arithmetic is done modulo the range of the sample type T: this gives the same results as
+// computing with int and allows compilers to vectorize the line loops with the narrowest possible lanes.
+
+// Computes (a + b) / 2 rounded down without the carry bit that would need a wider type than T.
+template<typename T>
+FORCE_INLINE T Average(T a, T b) noexcept
+{
+    return static_cast<T>((a & b) + ((a ^ b) >> 1));
+}
 
 template<typename T>
 struct TransformNoneImpl
@@ -63,7 +72,7 @@ struct TransformHp1 final
     }
 
 private:
-    static constexpr size_t Range = 1 << (sizeof(T) * 8);
+    static constexpr int32_t Range = 1 << (sizeof(T) * 8);
 };
 
 
@@ -83,20 +92,20 @@ struct TransformHp2 final
         FORCE_INLINE Triplet<T> operator()(int v1, int v2, int v3) const noexcept
         {
             Triplet<T> rgb;
-            rgb.R = static_cast<T>(v1 + v2 - Range / 2);                     // new R
-            rgb.G = static_cast<T>(v2);                                      // new G
-            rgb.B = static_cast<T>(v3 + ((rgb.R + rgb.G) >> 1) - Range / 2); // new B
+            rgb.R = static_cast<T>(v1 + v2 - Range / 2);                    // new R
+            rgb.G = static_cast<T>(v2);                                     // new G
+            rgb.B = static_cast<T>(v3 + Average(rgb.R, rgb.G) - Range / 2); // new B
             return rgb;
         }
     };
 
     FORCE_INLINE Triplet<T> operator()(int red, int green, int blue) const noexcept
     {
-        return Triplet<T>(red - green + Range / 2, green, blue - ((red + green) >> 1) - Range / 2);
+        return Triplet<T>(red - green + Range / 2, green, blue - Average(static_cast<T>(red), static_cast<T>(green)) - Range / 2);
     }
 
 private:
-    static constexpr size_t Range = 1 << (sizeof(T) * 8);
+    static constexpr int32_t Range = 1 << (sizeof(T) * 8);
 };
 
 
@@ -115,7 +124,7 @@ struct TransformHp3 final
 
         FORCE_INLINE Triplet<T> operator()(int v1, int v2, int v3) const noexcept
         {
-            const int G = v1 - ((v3 + v2) >> 2) + Range / 4;
+            const int G = v1 - (Average(static_cast<T>(v3), static_cast<T>(v2)) >> 1) + Range / 4;
             Triplet<T> rgb;
             rgb.R = static_cast<T>(v3 + G - Range / 2); // new R
             rgb.G = static_cast<T>(G);                  // new G
@@ -129,12 +138,12 @@ struct TransformHp3 final
         Triplet<T> hp3;
         hp3.v2 = static_cast<T>(blue - green + Range / 2);
         hp3.v3 = static_cast<T>(red - green + Range / 2);
-        hp3.v1 = static_cast<T>(green + ((hp3.v2 + hp3.v3) >> 2)) - Range / 4;
+        hp3.v1 = static_cast<T>(green + (Average(hp3.v2, hp3.v3) >> 1) - Range / 4);
         return hp3;
     }
 
 private:
-    static constexpr size_t Range = 1 << (sizeof(T) * 8);
+    static constexpr int32_t Range = 1 << (sizeof(T) * 8);
 };
 
 
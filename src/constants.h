@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 namespace charls
 {
 
@@ -18,4 +20,8 @@ constexpr int MaximumComponentCount = 255;
 constexpr int MinimumBitsPerSample = 2;
 constexpr int MaximumBitsPerSample = 16;
 
+// Size of the buffer in which the encoded data is collected before it is written to a destination stream.
+// A large buffer keeps the number of (virtual) stream calls low.
+constexpr std::size_t DefaultOutputBufferSize = 1024 * 1024;
+
 } // namespace charls
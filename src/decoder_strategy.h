@@ -8,6 +8,9 @@
 #include "process_line.h"
 #include "jpeg_marker_code.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <memory>
 #include <cassert>
 
@@ -33,6 +36,10 @@ public:
     virtual void SetPresets(const JpegLSPresetCodingParameters& presets) = 0;
     virtual void DecodeScan(std::unique_ptr<ProcessLine> outputData, const JlsRect& size, ByteStreamInfo& compressedData) = 0;
 
+    // Decodes a scan line by line: StartDecodeScan, DecodeLine for every line of the scan and EndScan.
+    virtual void StartDecodeScan(std::unique_ptr<ProcessLine> outputData, const JlsRect& size, ByteStreamInfo& compressedData) = 0;
+    virtual void DecodeLine() = 0;
+
     void Init(ByteStreamInfo& compressedStream)
     {
         validBits_ = 0;
@@ -81,12 +88,36 @@ public:
         endPosition_ += readBytes;
     }
 
+    uint8_t* GetPosition() const noexcept
+    {
+        return position_;
+    }
+
+    // Continues with encoded data that is received in parts: the unread bytes have been moved to position and
+    // bytes may have been added after them. Bytes in front of position are still needed by GetCurBytePos.
+    void SetPosition(uint8_t* position, uint8_t* endPosition) noexcept
+    {
+        position_ = position;
+        endPosition_ = endPosition;
+        nextFFPosition_ = FindNextFF();
+    }
+
     FORCE_INLINE void Skip(int32_t length) noexcept
     {
         validBits_ -= length;
         readCache_ = readCache_ << length;
     }
 
+    // Skips bits of which the value has been peeked. The bits after the end of the encoded data are read as 0 bits:
+    // a code that needs them means the encoded data ends too early.
+    FORCE_INLINE void SkipPeekedBits(int32_t length)
+    {
+        if (length > validBits_)
+            throw jpegls_error{jpegls_errc::invalid_encoded_data};
+
+        Skip(length);
+    }
+
     static void OnLineBegin(int32_t /*cpixel*/, void* /*ptypeBuffer*/, int32_t /*pixelStride*/) noexcept
     {
     }
@@ -110,6 +141,28 @@ public:
             throw jpegls_error{jpegls_errc::too_much_encoded_data};
     }
 
+    // Ends the current restart interval: checks that only padding bits remain, skips the RSTm marker and restarts the bit stream after it.
+    void EndRestartInterval(int32_t restartIndex)
+    {
+        AddBytesFromStream();
+        EndScan();
+
+        // Skip optional 0xFF fill bytes (see T.81, B.1.1.2) and the start byte of the marker.
+        while (position_ < endPosition_ && *position_ == JpegMarkerStartByte)
+        {
+            ++position_;
+        }
+
+        if (position_ == endPosition_ || *position_ != static_cast<int32_t>(JpegMarkerCode::Restart0) + restartIndex)
+            throw jpegls_error{jpegls_errc::restart_marker_not_found};
+
+        ++position_;
+        validBits_ = 0;
+        readCache_ = 0;
+        nextFFPosition_ = FindNextFF();
+        MakeValid();
+    }
+
     FORCE_INLINE bool OptimizedRead() noexcept
     {
         // Easy & fast: if there is no 0xFF byte in sight, we can read without bit stuffing
@@ -125,6 +178,23 @@ public:
         return false;
     }
 
+    // Reads the bytes in front of the next 0xFF byte with a single load, the bits of the bytes after them are masked out.
+    // This leaves only the 0xFF byte itself and the bytes after it to the byte by byte loop of MakeValid.
+    FORCE_INLINE void ReadBytesBeforeNextFF() noexcept
+    {
+        if (validBits_ < 0 || endPosition_ - position_ < static_cast<std::ptrdiff_t>(sizeof(bufType)))
+            return;
+
+        const std::ptrdiff_t byteCount = std::min(nextFFPosition_ - position_, static_cast<std::ptrdiff_t>((bufType_bit_count - 8 - validBits_) >> 3));
+        if (byteCount <= 0)
+            return;
+
+        const int32_t validBits = validBits_ + static_cast<int32_t>(byteCount) * 8;
+        readCache_ |= (FromBigEndian<sizeof(bufType)>::Read(position_) >> validBits_) & (~bufType{} << (bufType_bit_count - validBits));
+        position_ += byteCount;
+        validBits_ = validBits;
+    }
+
     void MakeValid()
     {
         ASSERT(static_cast<size_t>(validBits_) <=bufType_bit_count - 8);
@@ -133,6 +203,7 @@ public:
             return;
 
         AddBytesFromStream();
+        ReadBytesBeforeNextFF();
 
         do
         {
@@ -169,22 +240,18 @@ public:
         }
         while (static_cast<size_t>(validBits_) < bufType_bit_count - 8);
 
-        nextFFPosition_ = FindNextFF();
+        // There is no 0xFF byte between position_ and nextFFPosition_: only search again after it has been passed.
+        if (position_ > nextFFPosition_)
+        {
+            nextFFPosition_ = FindNextFF();
+        }
     }
 
     uint8_t* FindNextFF() const noexcept
     {
-        auto positionNextFF = position_;
-
-        while (positionNextFF < endPosition_)
-        {
-            if (*positionNextFF == JpegMarkerStartByte)
-                break;
-
-            positionNextFF++;
-        }
-
-        return positionNextFF;
+        // memchr is optimized (SIMD) by the C runtime libraries and much faster than a loop for high entropy data with only a few 0xFF bytes.
+        const auto positionNextFF = static_cast<uint8_t*>(std::memchr(position_, JpegMarkerStartByte, endPosition_ - position_));
+        return positionNextFF ? positionNextFF : endPosition_;
     }
 
     uint8_t* GetCurBytePos() const noexcept
@@ -204,6 +271,32 @@ public:
         }
     }
 
+    // Returns the position of the marker that ends the scan, or the end of the encoded data when it is missing.
+    // Inside encoded data a 0xFF byte is always followed by a value < 0x80 (see ITU-T.87, A.1): the first other marker,
+    // that is not a RSTm marker, ends the scan. Used to skip the lines of a scan that don't need to be decoded.
+    uint8_t* FindScanEnd() const noexcept
+    {
+        uint8_t* position = position_;
+        for (;;)
+        {
+            position = std::find(position, endPosition_, JpegMarkerStartByte);
+            uint8_t* const markerStart = position;
+
+            // Skip optional 0xFF fill bytes (see T.81, B.1.1.2).
+            while (position != endPosition_ && *position == JpegMarkerStartByte)
+            {
+                ++position;
+            }
+
+            if (position == endPosition_)
+                return endPosition_;
+
+            if (*position >= 0x80 && (*position < static_cast<uint8_t>(JpegMarkerCode::Restart0) ||
+                                      *position >= static_cast<uint8_t>(JpegMarkerCode::Restart0) + 8))
+                return markerStart;
+        }
+    }
+
     FORCE_INLINE int32_t ReadValue(int32_t length)
     {
         if (validBits_ < length)
@@ -220,14 +313,14 @@ public:
         return result;
     }
 
-    FORCE_INLINE int32_t PeekByte()
+    FORCE_INLINE int32_t PeekBits(int32_t bitCount)
     {
-        if (validBits_ < 8)
+        if (validBits_ < bitCount)
         {
             MakeValid();
         }
 
-        return static_cast<int32_t>(readCache_ >> (bufType_bit_count - 8));
+        return static_cast<int32_t>(readCache_ >> (bufType_bit_count - bitCount));
     }
 
     FORCE_INLINE bool ReadBit()
@@ -265,10 +358,10 @@ public:
         const int32_t count = Peek0Bits();
         if (count >= 0)
         {
-            Skip(count + 1);
+            SkipPeekedBits(count + 1);
             return count;
         }
-        Skip(15);
+        SkipPeekedBits(15);
 
         for (int32_t highBitsCount = 15; ; highBitsCount++)
         {
@@ -41,7 +41,8 @@ struct DefaultTraits final
           qbpp{log_2(RANGE)},
           bpp{log_2(max)},
           LIMIT{2 * (bpp + std::max(8, bpp))},
-          RESET{reset}
+          RESET{reset},
+          quantizationReciprocal_{(uint64_t{1} << QuantizationShift) / static_cast<uint64_t>(2 * near + 1) + 1}
     {
     }
 
@@ -52,7 +53,8 @@ struct DefaultTraits final
         qbpp{other.qbpp},
         bpp{other.bpp},
         LIMIT{other.LIMIT},
-        RESET{other.RESET}
+        RESET{other.RESET},
+        quantizationReciprocal_{other.quantizationReciprocal_}
     {
     }
 
@@ -84,6 +86,14 @@ struct DefaultTraits final
                std::abs(lhs.v3 - rhs.v3) <= NEAR;
     }
 
+    bool IsNear(Quad<SAMPLE> lhs, Quad<SAMPLE> rhs) const noexcept
+    {
+        return std::abs(lhs.v1 - rhs.v1) <= NEAR &&
+               std::abs(lhs.v2 - rhs.v2) <= NEAR &&
+               std::abs(lhs.v3 - rhs.v3) <= NEAR &&
+               std::abs(lhs.v4 - rhs.v4) <= NEAR;
+    }
+
     FORCE_INLINE int32_t CorrectPrediction(int32_t Pxc) const noexcept
     {
         if ((Pxc & MAXVAL) == Pxc)
@@ -99,26 +109,28 @@ struct DefaultTraits final
     {
         ASSERT(std::abs(errorValue) <= RANGE);
 
-        if (errorValue < 0)
-        {
-            errorValue += RANGE;
-        }
-        if (errorValue >= (RANGE + 1) / 2)
-        {
-            errorValue -= RANGE;
-        }
+        // Branch free: the sign of a difference selects RANGE or 0, the error values are random and mispredict branches.
+        errorValue += RANGE & (errorValue >> (int32_t_bit_count - 1));
+        errorValue -= RANGE & (((RANGE - 1) / 2 - errorValue) >> (int32_t_bit_count - 1));
 
         ASSERT(-RANGE / 2 <= errorValue && errorValue <= static_cast<int32_t>(ceil(static_cast<double>(RANGE) / 2)) - 1);
         return errorValue;
     }
 
 private:
-    int32_t Quantize(int32_t errorValue) const noexcept
+    // The quotient of n / (2 * NEAR + 1) is computed as (n * reciprocal) >> QuantizationShift, with reciprocal rounded up.
+    // This is exact when n * (2 * NEAR + 1) < 2^QuantizationShift: n <= MAXVAL + NEAR < 2^17 and 2 * NEAR + 1 < 2^16.
+    static constexpr int QuantizationShift = 40;
+
+    FORCE_INLINE int32_t Quantize(int32_t errorValue) const noexcept
     {
-        if (errorValue > 0)
-            return  (errorValue + NEAR) / (2 * NEAR + 1);
+        const int32_t sign = errorValue >> (int32_t_bit_count - 1);
+        const auto magnitude = static_cast<uint64_t>((errorValue ^ sign) - sign + NEAR);
+        ASSERT(magnitude * static_cast<uint64_t>(2 * NEAR + 1) < uint64_t{1} << QuantizationShift);
 
-        return - (NEAR - errorValue) / (2 * NEAR + 1);
+        const auto quotient = static_cast<int32_t>((magnitude * quantizationReciprocal_) >> QuantizationShift);
+        ASSERT(quotient == static_cast<int32_t>(magnitude) / (2 * NEAR + 1));
+        return (quotient ^ sign) - sign;
     }
 
     FORCE_INLINE int32_t DeQuantize(int32_t ErrorValue) const noexcept
@@ -139,6 +151,8 @@ private:
 
         return static_cast<SAMPLE>(CorrectPrediction(value));
     }
+
+    const uint64_t quantizationReciprocal_;
 };
 
 } // namespace charls
@@ -4,6 +4,7 @@
 
 #include "process_line.h"
 #include "decoder_strategy.h"
+#include "constants.h"
 
 namespace charls
 {
@@ -52,11 +53,18 @@ protected:
     {
         freeBitCount_ = sizeof(bitBuffer_) * 8;
         bitBuffer_ = 0;
+        isFFWritten_ = false;
+        bytesWritten_ = 0;
+        compressedStream_ = nullptr;
 
         if (compressedStream.rawStream)
         {
+            // The encoded data is in practice smaller than the pixels: a larger buffer would only waste memory.
+            const size_t pixelBytes = static_cast<size_t>(params_.width) * params_.height * params_.components * ((params_.bitsPerSample + 7) / 8);
+            const size_t bufferSize = params_.outputBufferSize > 0 ? static_cast<size_t>(params_.outputBufferSize) : DefaultOutputBufferSize;
             compressedStream_ = compressedStream.rawStream;
-            buffer_.resize(4000);
+            // The buffer must at least hold a full bit buffer or a marker.
+            buffer_.resize(std::max(std::min(bufferSize, pixelBytes + 1024), sizeof(bitBuffer_)));
             position_ = buffer_.data();
             compressedLength_ = buffer_.size();
         }
@@ -79,43 +87,66 @@ protected:
         freeBitCount_ -= bitCount;
         if (freeBitCount_ >= 0)
         {
-            bitBuffer_ |= bits << freeBitCount_;
+            bitBuffer_ |= static_cast<uint64_t>(bits) << freeBitCount_;
         }
         else
         {
             // Add as much bits in the remaining space as possible and flush.
-            bitBuffer_ |= bits >> -freeBitCount_;
+            // Flush writes 8 bytes of the full buffer and a stuffed byte is never 0xFF: at least 60 bits are written and
+            // the remaining bits (less than 32) always fit.
+            bitBuffer_ |= static_cast<uint64_t>(bits) >> -freeBitCount_;
             Flush();
 
-            // A second flush may be required if extra marker detect bits were needed and not all bits could be written.
-            if (freeBitCount_ < 0)
-            {
-                bitBuffer_ |= bits >> -freeBitCount_;
-                Flush();
-            }
-
             ASSERT(freeBitCount_ >= 0);
-            bitBuffer_ |= bits << freeBitCount_;
+            bitBuffer_ |= static_cast<uint64_t>(bits) << freeBitCount_;
         }
     }
 
     void EndScan()
     {
-        Flush();
+        EndBitStream();
 
-        // if a 0xff was written, Flush() will force one unset bit anyway
-        if (isFFWritten_)
-            AppendToBitStream(0, (freeBitCount_ - 1) % 8);
-        else
-            AppendToBitStream(0, freeBitCount_ % 8);
+        if (compressedStream_)
+        {
+            OverFlow();
+        }
+    }
 
-        Flush();
-        ASSERT(freeBitCount_ == 0x20);
+    // Ends the current restart interval: pads the bit stream to a byte boundary and writes the RSTm marker.
+    // The buffered bytes are not yet written to a destination stream.
+    void EndRestartInterval(int32_t restartIndex)
+    {
+        EndBitStream();
 
-        if (compressedStream_)
+        if (compressedLength_ < 2)
         {
             OverFlow();
         }
+
+        position_[0] = JpegMarkerStartByte;
+        position_[1] = static_cast<uint8_t>(static_cast<int32_t>(JpegMarkerCode::Restart0) + restartIndex);
+        position_ += 2;
+        compressedLength_ -= 2;
+        bytesWritten_ += 2;
+    }
+
+    // Writes the remaining bits, the last byte is padded with zero bits.
+    void EndBitStream()
+    {
+        while (freeBitCount_ < bitBuffer_bit_count)
+        {
+            Flush();
+        }
+        freeBitCount_ = bitBuffer_bit_count;
+
+        // A 0xFF byte must be followed by a 0 bit (T.87, A.1): a byte with only the 7 zero bits after it is added.
+        if (isFFWritten_)
+        {
+            AppendToBitStream(0, 7);
+            Flush();
+        }
+
+        ASSERT(freeBitCount_ == bitBuffer_bit_count && !isFFWritten_);
     }
 
     void OverFlow()
@@ -135,26 +166,38 @@ protected:
 
     void Flush()
     {
-        if (compressedLength_ < 4)
+        // Fast path: a full buffer without 0xFF bytes is written with a single store, no bits need to be stuffed.
+        if (freeBitCount_ <= 0 && !isFFWritten_ && !ContainsFFByte(bitBuffer_) && compressedLength_ >= sizeof(bitBuffer_))
         {
-            OverFlow();
+            ToBigEndian<sizeof(bitBuffer_)>::Write(position_, bitBuffer_);
+            bitBuffer_ = 0;
+            freeBitCount_ += bitBuffer_bit_count;
+            position_ += sizeof(bitBuffer_);
+            compressedLength_ -= sizeof(bitBuffer_);
+            bytesWritten_ += sizeof(bitBuffer_);
+            return;
         }
 
-        for (int i = 0; i < 4; ++i)
+        for (size_t i = 0; i < sizeof(bitBuffer_); ++i)
         {
-            if (freeBitCount_ >= 32)
+            if (freeBitCount_ >= bitBuffer_bit_count)
                 break;
 
+            if (compressedLength_ == 0)
+            {
+                OverFlow();
+            }
+
             if (isFFWritten_)
             {
                 // JPEG-LS requirement (T.87, A.1) to detect markers: after a xFF value a single 0 bit needs to be inserted.
-                *position_ = static_cast<uint8_t>(bitBuffer_ >> 25);
+                *position_ = static_cast<uint8_t>(bitBuffer_ >> (bitBuffer_bit_count - 7));
                 bitBuffer_ = bitBuffer_ << 7;
                 freeBitCount_ += 7;
             }
             else
             {
-                *position_ = static_cast<uint8_t>(bitBuffer_ >> 24);
+                *position_ = static_cast<uint8_t>(bitBuffer_ >> (bitBuffer_bit_count - 8));
                 bitBuffer_ = bitBuffer_ << 8;
                 freeBitCount_ += 8;
             }
@@ -168,7 +211,7 @@ protected:
 
     std::size_t GetLength() const noexcept
     {
-        return bytesWritten_ - (freeBitCount_ - 32) / 8;
+        return bytesWritten_ - (freeBitCount_ - bitBuffer_bit_count) / 8;
     }
 
     FORCE_INLINE void AppendOnesToBitStream(int32_t length)
@@ -182,7 +225,16 @@ protected:
     std::unique_ptr<ProcessLine> processLine_;
 
 private:
-    unsigned int bitBuffer_;
+    // Returns true when one of the bytes is 0xFF: the inverted byte is then 0, which leaves its high bit set after the subtraction.
+    FORCE_INLINE static bool ContainsFFByte(uint64_t value) noexcept
+    {
+        const uint64_t inverted = ~value;
+        return ((inverted - 0x0101010101010101) & ~inverted & 0x8080808080808080) != 0;
+    }
+
+    static constexpr int32_t bitBuffer_bit_count = 64;
+
+    uint64_t bitBuffer_;
     int32_t freeBitCount_;
     std::size_t compressedLength_;
 
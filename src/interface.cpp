@@ -8,10 +8,22 @@
 #include "jpegls_preset_coding_parameters.h"
 #include "encoder_strategy.h"
 #include "jls_codec_factory.h"
+#include "jpeg_stream_push_reader.h"
+#include "mapped_file.h"
+#include "parallel_for.h"
 #include "util.h"
 #include "constants.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
 using namespace charls;
+using std::vector;
 
 namespace {
 
@@ -29,6 +41,9 @@ void VerifyInput(const ByteStreamInfo& destination, const JlsParameters& paramet
     if (parameters.components < 1 || parameters.components > MaximumComponentCount)
         throw jpegls_error{jpegls_errc::invalid_argument_component_count};
 
+    if (parameters.restartInterval < 0 || parameters.restartInterval > UINT16_MAX)
+        throw jpegls_error{jpegls_errc::invalid_argument};
+
     if (destination.rawData &&
         destination.count < static_cast<size_t>(parameters.height) * parameters.width * parameters.components * (parameters.bitsPerSample > 8 ? 2 : 1))
         throw jpegls_error{jpegls_errc::destination_buffer_too_small};
@@ -36,10 +51,7 @@ void VerifyInput(const ByteStreamInfo& destination, const JlsParameters& paramet
     switch (parameters.components)
     {
     case 3:
-        break;
     case 4:
-        if (parameters.interleaveMode == InterleaveMode::Sample)
-            throw jpegls_error{jpegls_errc::invalid_argument_interleave_mode};
         break;
     default:
         if (parameters.interleaveMode != InterleaveMode::None)
@@ -70,93 +82,417 @@ jpegls_errc to_jpegls_errc() noexcept
     }
 }
 
-void EncodeScan(const JlsParameters& params, int componentCount, ByteStreamInfo source, JpegStreamWriter& writer)
+void EncodeScan(const JlsParameters& params, int componentCount, ByteStreamInfo source, JpegStreamWriter& writer, JlsCodecCache<EncoderStrategy>& codecCache)
 {
     JlsParameters info{params};
     info.components = componentCount;
 
-    auto codec = JlsCodecFactory<EncoderStrategy>().CreateCodec(info, info.custom);
-    std::unique_ptr<ProcessLine> processLine(codec->CreateProcess(source));
+    EncoderStrategy& codec = codecCache.GetCodec(info, info.custom);
+    std::unique_ptr<ProcessLine> processLine(codec.CreateProcess(source));
     ByteStreamInfo destination{writer.OutputStream()};
-    const size_t bytesWritten = codec->EncodeScan(move(processLine), destination);
+    const size_t bytesWritten = codec.EncodeScan(move(processLine), destination);
 
     // Synchronize the destination encapsulated in the writer (EncodeScan works on a local copy)
     writer.Seek(bytesWritten);
 }
 
-} // namespace
 
+// Encodes the scans (one per component when the interleave mode is None) and their restart intervals concurrently, each one into
+// its own buffer, and then writes them in order. The result is identical to encoding the scans one after another.
+void EncodeScansConcurrently(const JlsParameters& params, ByteStreamInfo source, JpegStreamWriter& writer)
+{
+    const int scanCount = params.interleaveMode == InterleaveMode::None ? params.components : 1;
+    const int componentCountInScan = params.interleaveMode == InterleaveMode::None ? 1 : params.components;
+    const int32_t restartInterval = params.restartInterval != 0 ? params.restartInterval : params.height;
+    const size_t intervalCount = static_cast<size_t>((params.height + restartInterval - 1) / restartInterval);
+    const size_t bytesPerSample = (params.bitsPerSample + 7) / 8;
+    const size_t byteCountComponent = static_cast<size_t>(params.width) * params.height * bytesPerSample;
+    const size_t capacity = writer.GetLength();
+    const size_t limit = static_cast<size_t>(2 * (params.bitsPerSample + std::max(8, params.bitsPerSample)));
+    vector<vector<uint8_t>> intervals(scanCount * intervalCount);
+
+    ParallelFor(intervals.size(), params.threadCount, [&](size_t index) {
+        const size_t scan = index / intervalCount;
+        const int32_t firstLine = static_cast<int32_t>(index % intervalCount) * restartInterval;
 
-jpegls_errc JpegLsEncodeStream(ByteStreamInfo destination, size_t& bytesWritten,
-                               ByteStreamInfo source, const JlsParameters& params)
+        JlsParameters info{params};
+        info.components = componentCountInScan;
+        info.height = std::min(restartInterval, params.height - firstLine);
+        info.restartInterval = 0;
+
+        ByteStreamInfo intervalSource{source};
+        SkipBytes(intervalSource, scan * byteCountComponent + static_cast<size_t>(firstLine) * params.stride);
+
+        // Start with a buffer that fits a compressed interval in practice, only data that cannot be compressed needs a second try.
+        // The second try uses the worst case size: every sample coded with LIMIT bits (one more bit for the run at the end of
+        // a line) and a stuffed bit after every byte, which leaves 7 bits per byte.
+        const size_t sampleCount = static_cast<size_t>(info.height) * params.width * componentCountInScan;
+        const size_t rawSize = sampleCount * bytesPerSample;
+        const size_t worstCaseSize = (sampleCount * limit + static_cast<size_t>(info.height) * componentCountInScan) / 7 + 2 * sizeof(uint64_t);
+        const size_t maximumSize = std::min(capacity, worstCaseSize);
+        vector<uint8_t>& encoded = intervals[index];
+        for (size_t size = std::min(maximumSize, rawSize + rawSize / 4 + 1024);; size = maximumSize)
+        {
+            encoded.resize(size);
+            ByteStreamInfo destination{FromByteArray(encoded.data(), encoded.size())};
+
+            try
+            {
+                auto codec = JlsCodecFactory<EncoderStrategy>().CreateCodec(info, info.custom);
+                std::unique_ptr<ProcessLine> processLine(codec->CreateProcess(intervalSource));
+                encoded.resize(codec->EncodeScan(move(processLine), destination));
+                return;
+            }
+            catch (const jpegls_error& error)
+            {
+                if (error.code() != jpegls_errc::destination_buffer_too_small || size == maximumSize)
+                    throw;
+            }
+        }
+    });
+
+    for (size_t index = 0; index < intervals.size(); ++index)
+    {
+        const size_t intervalIndex = index % intervalCount;
+        if (intervalIndex == 0)
+        {
+            writer.WriteStartOfScanSegment(componentCountInScan, params.allowedLossyError, params.interleaveMode);
+        }
+        else
+        {
+            writer.WriteRestartMarker(static_cast<int32_t>((intervalIndex - 1) % 8));
+        }
+
+        writer.WriteEncodedData(intervals[index].data(), intervals[index].size());
+    }
+}
+
+
+// Encodes an image, the scans that are not encoded concurrently use the codecs of the cache.
+void EncodeStream(ByteStreamInfo destination, size_t& bytesWritten, ByteStreamInfo source, const JlsParameters& params,
+                  JlsCodecCache<EncoderStrategy>& codecCache)
 {
     if (params.width < 1 || params.width > 65535)
-        return jpegls_errc::invalid_argument_width;
+        throw jpegls_error{jpegls_errc::invalid_argument_width};
 
     if (params.height < 1 || params.height > 65535)
-        return jpegls_errc::invalid_argument_height;
+        throw jpegls_error{jpegls_errc::invalid_argument_height};
 
-    try
-    {
-        VerifyInput(source, params);
+    VerifyInput(source, params);
 
-        JlsParameters info{params};
-        if (info.stride == 0)
+    JlsParameters info{params};
+    if (info.stride == 0)
+    {
+        info.stride = info.width * ((info.bitsPerSample + 7) / 8);
+        if (info.interleaveMode != InterleaveMode::None)
         {
-            info.stride = info.width * ((info.bitsPerSample + 7) / 8);
-            if (info.interleaveMode != InterleaveMode::None)
-            {
-                info.stride *= info.components;
-            }
+            info.stride *= info.components;
         }
+    }
+
+    JpegStreamWriter writer{destination};
+
+    writer.WriteStartOfImage();
+
+    if (info.jfif.version != 0)
+    {
+        writer.WriteJpegFileInterchangeFormatSegment(info.jfif);
+    }
 
-        JpegStreamWriter writer{destination};
+    writer.WriteStartOfFrameSegment(info.width, info.height, info.bitsPerSample, info.components);
 
-        writer.WriteStartOfImage();
+    if (info.colorTransformation != ColorTransformation::None)
+    {
+        writer.WriteColorTransformSegment(info.colorTransformation);
+    }
 
-        if (info.jfif.version != 0)
+    if (!IsDefault(info.custom))
+    {
+        writer.WriteJpegLSPresetParametersSegment(info.custom);
+    }
+    else if (info.bitsPerSample > 12)
+    {
+        const JpegLSPresetCodingParameters preset = ComputeDefault((1 << info.bitsPerSample) - 1, info.allowedLossyError);
+        writer.WriteJpegLSPresetParametersSegment(preset);
+    }
+
+    if (info.restartInterval != 0)
+    {
+        writer.WriteDefineRestartIntervalSegment(info.restartInterval);
+    }
+
+    if (info.threadCount > 1 && source.rawData && destination.rawData &&
+        ((info.interleaveMode == InterleaveMode::None && info.components > 1) || (info.restartInterval != 0 && info.restartInterval < info.height)))
+    {
+        EncodeScansConcurrently(info, source, writer);
+    }
+    else if (info.interleaveMode == InterleaveMode::None)
+    {
+        const int32_t byteCountComponent = info.width * info.height * ((info.bitsPerSample + 7) / 8);
+        for (int32_t component = 0; component < info.components; ++component)
         {
-            writer.WriteJpegFileInterchangeFormatSegment(info.jfif);
+            writer.WriteStartOfScanSegment(1, info.allowedLossyError, info.interleaveMode);
+            EncodeScan(info, 1, source, writer, codecCache);
+
+            // Synchronize the source stream (EncodeScan works on a local copy)
+            SkipBytes(source, byteCountComponent);
         }
+    }
+    else
+    {
+        writer.WriteStartOfScanSegment(info.components, info.allowedLossyError, info.interleaveMode);
+        EncodeScan(info, info.components, source, writer, codecCache);
+    }
+
+    writer.WriteEndOfImage();
+
+    bytesWritten = writer.GetBytesWritten();
+}
+
+
+// Passes the decoded rows to the line sink of the caller. The rows are counted from the bytes that are written to the stream:
+// complete rows are passed on without a copy, rows that are written in parts are collected first.
+class LineSinkBuffer final : public std::basic_streambuf<char>
+{
+public:
+    LineSinkBuffer(charls_jpegls_line_sink lineSink, void* context, const JlsParameters& params) noexcept :
+        lineSink_{lineSink},
+        context_{context},
+        params_{params}
+    {
+    }
 
-        writer.WriteStartOfFrameSegment(info.width, info.height, info.bitsPerSample, info.components);
+protected:
+    std::streamsize xsputn(const char* pixels, std::streamsize count) override
+    {
+        // The metadata is complete when the first row is decoded, not when the line sink is created.
+        const size_t rowSize = static_cast<size_t>(params_.width) * ((params_.bitsPerSample + 7) / 8) *
+                               (params_.interleaveMode == InterleaveMode::None ? 1 : params_.components);
 
-        if (info.colorTransformation != ColorTransformation::None)
+        size_t remaining = static_cast<size_t>(count);
+        while (remaining != 0)
         {
-            writer.WriteColorTransformSegment(info.colorTransformation);
+            if (rowBytes_ == 0 && remaining >= rowSize)
+            {
+                PassRow(pixels, rowSize);
+                pixels += rowSize;
+                remaining -= rowSize;
+                continue;
+            }
+
+            row_.resize(rowSize);
+            const size_t bytesToCopy = std::min(remaining, rowSize - rowBytes_);
+            std::copy_n(pixels, bytesToCopy, row_.data() + rowBytes_);
+            rowBytes_ += bytesToCopy;
+            pixels += bytesToCopy;
+            remaining -= bytesToCopy;
+            if (rowBytes_ == rowSize)
+            {
+                rowBytes_ = 0;
+                PassRow(row_.data(), rowSize);
+            }
         }
 
-        if (!IsDefault(info.custom))
+        return count;
+    }
+
+    int_type overflow(int_type value) override
+    {
+        if (!traits_type::eq_int_type(value, traits_type::eof()))
         {
-            writer.WriteJpegLSPresetParametersSegment(info.custom);
+            const char pixel = traits_type::to_char_type(value);
+            xsputn(&pixel, 1);
         }
-        else if (info.bitsPerSample > 12)
+
+        return traits_type::not_eof(value);
+    }
+
+private:
+    void PassRow(const char* pixels, size_t rowSize)
+    {
+        lineSink_(context_, rowIndex_ % params_.height, rowIndex_ / params_.height, pixels, rowSize);
+        ++rowIndex_;
+    }
+
+    charls_jpegls_line_sink lineSink_;
+    void* context_;
+    const JlsParameters& params_;
+    int32_t rowIndex_{};
+    vector<char> row_;
+    size_t rowBytes_{};
+};
+
+
+// Requests the rows to encode from the row source of the caller: the ProcessLine objects read the rows from a stream with sgetn.
+// A request for a complete row is passed on without a copy.
+class RowSourceBuffer final : public std::basic_streambuf<char>
+{
+public:
+    RowSourceBuffer(charls_jpegls_row_source rowSource, void* context, const JlsParameters& params) :
+        rowSource_{rowSource},
+        context_{context},
+        height_{params.height},
+        rowCount_{params.height * (params.interleaveMode == InterleaveMode::None ? params.components : 1)},
+        // The single component stream reader expects 16 bit samples in big endian byte order (like PGM files).
+        swapBytes_{(params.interleaveMode == InterleaveMode::None || params.components == 1) && params.bitsPerSample > 8},
+        row_(params.stride)
+    {
+    }
+
+protected:
+    std::streamsize xsgetn(char* pixels, std::streamsize count) override
+    {
+        if (gptr() == egptr() && static_cast<size_t>(count) == row_.size())
+            return ReadRow(pixels) ? count : 0;
+
+        return std::basic_streambuf<char>::xsgetn(pixels, count);
+    }
+
+    int_type underflow() override
+    {
+        if (!ReadRow(row_.data()))
+            return traits_type::eof();
+
+        setg(row_.data(), row_.data(), row_.data() + row_.size());
+        return traits_type::to_int_type(row_[0]);
+    }
+
+private:
+    bool ReadRow(char* pixels)
+    {
+        if (rowIndex_ == rowCount_ || rowSource_(context_, rowIndex_ % height_, rowIndex_ / height_, pixels, row_.size()) != 0)
+            return false;
+
+        if (swapBytes_)
         {
-            const JpegLSPresetCodingParameters preset = ComputeDefault((1 << info.bitsPerSample) - 1, info.allowedLossyError);
-            writer.WriteJpegLSPresetParametersSegment(preset);
+            ByteSwap(pixels, static_cast<int>(row_.size()));
         }
 
-        if (info.interleaveMode == InterleaveMode::None)
-        {
-            const int32_t byteCountComponent = info.width * info.height * ((info.bitsPerSample + 7) / 8);
-            for (int32_t component = 0; component < info.components; ++component)
-            {
-                writer.WriteStartOfScanSegment(1, info.allowedLossyError, info.interleaveMode);
-                EncodeScan(info, 1, source, writer);
+        ++rowIndex_;
+        return true;
+    }
 
-                // Synchronize the source stream (EncodeScan works on a local copy)
-                SkipBytes(source, byteCountComponent);
-            }
+    charls_jpegls_row_source rowSource_;
+    void* context_;
+    int32_t height_;
+    int32_t rowCount_;
+    bool swapBytes_;
+    int32_t rowIndex_{};
+    vector<char> row_;
+};
+
+
+// Passes the encoded bytes to the byte sink of the caller. Single bytes (of the JPEG header) are collected first.
+class ByteSinkBuffer final : public std::basic_streambuf<char>
+{
+public:
+    ByteSinkBuffer(charls_jpegls_byte_sink byteSink, void* context) :
+        byteSink_{byteSink},
+        context_{context},
+        buffer_(4096)
+    {
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+    size_t GetBytesWritten() const noexcept
+    {
+        return bytesWritten_;
+    }
+
+protected:
+    std::streamsize xsputn(const char* bytes, std::streamsize count) override
+    {
+        if (sync() != 0 || !Write(bytes, static_cast<size_t>(count)))
+            return 0;
+
+        return count;
+    }
+
+    int_type overflow(int_type value) override
+    {
+        if (sync() != 0)
+            return traits_type::eof();
+
+        if (!traits_type::eq_int_type(value, traits_type::eof()))
+        {
+            sputc(traits_type::to_char_type(value));
         }
-        else
+
+        return traits_type::not_eof(value);
+    }
+
+    int sync() override
+    {
+        const size_t count = static_cast<size_t>(pptr() - pbase());
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+        return count == 0 || Write(buffer_.data(), count) ? 0 : -1;
+    }
+
+private:
+    bool Write(const char* bytes, size_t count)
+    {
+        if (failed_ || byteSink_(context_, bytes, count) != 0)
         {
-            writer.WriteStartOfScanSegment(info.components, info.allowedLossyError, info.interleaveMode);
-            EncodeScan(info, info.components, source, writer);
+            failed_ = true;
+            return false;
         }
 
-        writer.WriteEndOfImage();
+        bytesWritten_ += count;
+        return true;
+    }
 
-        bytesWritten = writer.GetBytesWritten();
+    charls_jpegls_byte_sink byteSink_;
+    void* context_;
+    vector<char> buffer_;
+    size_t bytesWritten_{};
+    bool failed_{};
+};
+
+
+// Decodes an image, the scans that are not decoded concurrently use the codecs of the cache (when not null).
+void DecodeStream(ByteStreamInfo destination, ByteStreamInfo source, const JlsParameters* params, JlsCodecCache<DecoderStrategy>* codecCache)
+{
+    JpegStreamReader reader{source};
+
+    if (params)
+    {
+        reader.SetInfo(*params);
+    }
+
+    reader.SetCodecCache(codecCache);
+    reader.Read(destination);
+}
+
+} // namespace
+
+
+struct charls_jpegls_decoder final
+{
+    JlsCodecCache<DecoderStrategy> codecCache;
+};
+
+
+struct charls_jpegls_encoder final
+{
+    JlsCodecCache<EncoderStrategy> codecCache;
+};
+
+
+struct charls_jpegls_push_decoder final
+{
+    JpegStreamPushReader reader;
+    std::unique_ptr<LineSinkBuffer> lineSink;
+    jpegls_errc error{};
+};
+
+
+jpegls_errc JpegLsEncodeStream(ByteStreamInfo destination, size_t& bytesWritten,
+                               ByteStreamInfo source, const JlsParameters& params)
+{
+    try
+    {
+        JlsCodecCache<EncoderStrategy> codecCache;
+        EncodeStream(destination, bytesWritten, source, params, codecCache);
 
         return jpegls_errc::success;
     }
@@ -171,14 +507,7 @@ jpegls_errc JpegLsDecodeStream(ByteStreamInfo destination, ByteStreamInfo source
 {
     try
     {
-        JpegStreamReader reader{source};
-
-        if (params)
-        {
-            reader.SetInfo(*params);
-        }
-
-        reader.Read(destination);
+        DecodeStream(destination, source, params, nullptr);
 
         return jpegls_errc::success;
     }
@@ -264,4 +593,410 @@ JpegLsDecodeRect(void* destination, size_t destinationLength, const void* source
     }
 }
 
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_decode_to_line_sink(const void* source, size_t sourceLength, const JlsParameters* params, charls_jpegls_line_sink lineSink, void* context)
+{
+    if (!lineSink)
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        // The line sink uses the metadata of the reader that decodes: the interleave mode is known when the scan starts.
+        JpegStreamReader reader{FromByteArrayConst(source, sourceLength)};
+        if (params)
+        {
+            reader.SetInfo(*params);
+        }
+
+        LineSinkBuffer lineSinkBuffer{lineSink, context, reader.GetMetadata()};
+        reader.Read({&lineSinkBuffer, nullptr, 0});
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+}
+
+
+charls_jpegls_decoder* CHARLS_API_CALLING_CONVENTION
+charls_jpegls_decoder_create()
+{
+    return new (std::nothrow) charls_jpegls_decoder;
+}
+
+
+void CHARLS_API_CALLING_CONVENTION
+charls_jpegls_decoder_destroy(const charls_jpegls_decoder* decoder)
+{
+    delete decoder;
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_decoder_decode(charls_jpegls_decoder* decoder, void* destination, size_t destinationLength, const void* source, size_t sourceLength, const JlsParameters* params)
+{
+    if (!decoder)
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        DecodeStream(FromByteArray(destination, destinationLength), FromByteArrayConst(source, sourceLength), params, &decoder->codecCache);
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_decoder_decode_file(charls_jpegls_decoder* decoder, const char* sourcePath, void* destination, size_t destinationLength, const JlsParameters* params)
+{
+    if (!decoder || !sourcePath)
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        const MappedFile source{MappedFile::OpenRead(sourcePath)};
+        DecodeStream(FromByteArray(destination, destinationLength), FromByteArrayConst(source.GetData(), source.GetSize()), params, &decoder->codecCache);
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_decoder_decode_file_to_file(charls_jpegls_decoder* decoder, const char* sourcePath, const char* destinationPath, const JlsParameters* params)
+{
+    if (!decoder || !sourcePath || !destinationPath)
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        const MappedFile source{MappedFile::OpenRead(sourcePath)};
+        const ByteStreamInfo sourceInfo{FromByteArrayConst(source.GetData(), source.GetSize())};
+
+        JpegStreamReader reader{sourceInfo};
+        reader.ReadHeader();
+        const JlsParameters& metadata = reader.GetMetadata();
+
+        // The destination file holds the pixels without padding between the rows.
+        JlsParameters decodeParams = params ? *params : JlsParameters{};
+        decodeParams.stride = 0;
+        const size_t destinationSize = static_cast<size_t>(metadata.width) * metadata.height * metadata.components * ((metadata.bitsPerSample + 7) / 8);
+
+        bool destinationCreated{};
+        try
+        {
+            const MappedFile destination{MappedFile::Create(destinationPath, destinationSize)};
+            destinationCreated = true;
+            DecodeStream(FromByteArray(destination.GetData(), destination.GetSize()), sourceInfo, &decodeParams, &decoder->codecCache);
+        }
+        catch (...)
+        {
+            // The destination is unmapped at this point: a file with incomplete pixel data is not left behind.
+            if (destinationCreated)
+            {
+                std::remove(destinationPath);
+            }
+            throw;
+        }
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+}
+
+
+charls_jpegls_encoder* CHARLS_API_CALLING_CONVENTION
+charls_jpegls_encoder_create()
+{
+    return new (std::nothrow) charls_jpegls_encoder;
+}
+
+
+void CHARLS_API_CALLING_CONVENTION
+charls_jpegls_encoder_destroy(const charls_jpegls_encoder* encoder)
+{
+    delete encoder;
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_encoder_encode(charls_jpegls_encoder* encoder, void* destination, size_t destinationLength, size_t* bytesWritten,
+                             const void* source, size_t sourceLength, const JlsParameters* params)
+{
+    if (!encoder || !destination || !bytesWritten || !source || !params)
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        EncodeStream(FromByteArray(destination, destinationLength), *bytesWritten, FromByteArrayConst(source, sourceLength), *params, encoder->codecCache);
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_encoder_encode_file(charls_jpegls_encoder* encoder, const char* sourcePath, const char* destinationPath,
+                                  const JlsParameters* params, size_t* bytesWritten)
+{
+    if (!encoder || !sourcePath || !destinationPath || !params || !bytesWritten)
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        const MappedFile source{MappedFile::OpenRead(sourcePath)};
+
+        // The size of the encoded data is not known in advance: it is written through the buffer of a file stream.
+        std::filebuf destination;
+        bool destinationCreated{};
+        std::streamoff fileSize{};
+        try
+        {
+            if (!destination.open(destinationPath, std::ios::out | std::ios::binary | std::ios::trunc))
+                throw jpegls_error{jpegls_errc::invalid_argument_destination};
+
+            destinationCreated = true;
+            EncodeStream({&destination, nullptr, 0}, *bytesWritten, FromByteArrayConst(source.GetData(), source.GetSize()), *params, encoder->codecCache);
+
+            // The stream writer doesn't count the bytes: the position of the file is the number of bytes written.
+            fileSize = destination.pubseekoff(0, std::ios::cur, std::ios::out);
+            if (fileSize < 0 || !destination.close())
+                throw jpegls_error{jpegls_errc::destination_buffer_too_small};
+        }
+        catch (...)
+        {
+            // The destination is closed first: a file with incomplete encoded data is not left behind.
+            if (destinationCreated)
+            {
+                destination.close();
+                std::remove(destinationPath);
+            }
+            throw;
+        }
+
+        *bytesWritten = static_cast<size_t>(fileSize);
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_encoder_encode_rows(charls_jpegls_encoder* encoder, charls_jpegls_row_source rowSource, charls_jpegls_byte_sink byteSink,
+                                  void* context, const JlsParameters* params, size_t* bytesWritten)
+{
+    if (!encoder || !rowSource || !byteSink || !params || !bytesWritten)
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        JlsParameters info{*params};
+        info.stride = info.width * ((info.bitsPerSample + 7) / 8) * (info.interleaveMode == InterleaveMode::None ? 1 : info.components);
+
+        RowSourceBuffer rowSourceBuffer{rowSource, context, info};
+        ByteSinkBuffer byteSinkBuffer{byteSink, context};
+        size_t streamBytesWritten{};
+        EncodeStream({&byteSinkBuffer, nullptr, 0}, streamBytesWritten, {&rowSourceBuffer, nullptr, 0}, info, encoder->codecCache);
+        if (byteSinkBuffer.pubsync() != 0)
+            throw jpegls_error{jpegls_errc::destination_buffer_too_small};
+
+        *bytesWritten = byteSinkBuffer.GetBytesWritten();
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_decode_batch(charls_jpegls_decoder* const* decoders, int32_t decoderCount, const JlsDecodeBatchItem* items, size_t count, jpegls_errc* results)
+{
+    if (count == 0)
+        return jpegls_errc::success;
+
+    if (!items || !results)
+        return jpegls_errc::invalid_argument;
+
+    if (decoders)
+    {
+        if (decoderCount <= 0 || std::any_of(decoders, decoders + decoderCount, [](const charls_jpegls_decoder* decoder) { return !decoder; }))
+            return jpegls_errc::invalid_argument;
+    }
+    else if (decoderCount <= 0)
+    {
+        decoderCount = static_cast<int32_t>(std::max(std::thread::hardware_concurrency(), 1U));
+    }
+
+    try
+    {
+        std::vector<charls_jpegls_decoder> temporaryDecoders(decoders ? 0 : ParallelWorkerCount(count, decoderCount));
+
+        ParallelForWorker(count, decoderCount, [&](size_t index, size_t workerIndex)
+        {
+            const JlsDecodeBatchItem& item = items[index];
+            JlsCodecCache<DecoderStrategy>& codecCache = decoders ? decoders[workerIndex]->codecCache : temporaryDecoders[workerIndex].codecCache;
+
+            try
+            {
+                DecodeStream(FromByteArray(item.destination, item.destinationLength), FromByteArrayConst(item.source, item.sourceLength), nullptr, &codecCache);
+                results[index] = jpegls_errc::success;
+            }
+            catch (...)
+            {
+                results[index] = to_jpegls_errc();
+            }
+        });
+    }
+    catch (...)
+    {
+        return to_jpegls_errc();
+    }
+
+    const auto failed = std::find_if(results, results + count, [](jpegls_errc result) { return result != jpegls_errc::success; });
+    return failed == results + count ? jpegls_errc::success : *failed;
+}
+
+
+charls_jpegls_push_decoder* CHARLS_API_CALLING_CONVENTION
+charls_jpegls_push_decoder_create()
+{
+    return new (std::nothrow) charls_jpegls_push_decoder;
+}
+
+
+void CHARLS_API_CALLING_CONVENTION
+charls_jpegls_push_decoder_destroy(const charls_jpegls_push_decoder* decoder)
+{
+    delete decoder;
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_push_decoder_feed(charls_jpegls_push_decoder* decoder, const void* source, size_t sourceLength)
+{
+    if (!decoder || (!source && sourceLength != 0))
+        return jpegls_errc::invalid_argument;
+
+    if (decoder->error != jpegls_errc::success)
+        return decoder->error;
+
+    try
+    {
+        decoder->reader.Feed(static_cast<const uint8_t*>(source), sourceLength);
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        decoder->error = to_jpegls_errc();
+        return decoder->error;
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_push_decoder_read_header(charls_jpegls_push_decoder* decoder, JlsParameters* params)
+{
+    if (!decoder || !params)
+        return jpegls_errc::invalid_argument;
+
+    if (decoder->error != jpegls_errc::success)
+        return decoder->error;
+
+    if (!decoder->reader.IsHeaderRead())
+        return jpegls_errc::source_buffer_too_small;
+
+    *params = decoder->reader.GetMetadata();
+    return jpegls_errc::success;
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_push_decoder_set_destination(charls_jpegls_push_decoder* decoder, void* destination, size_t destinationLength)
+{
+    if (!decoder || !destination)
+        return jpegls_errc::invalid_argument;
+
+    if (decoder->error != jpegls_errc::success)
+        return decoder->error;
+
+    if (decoder->reader.IsDecodingStarted())
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        decoder->reader.SetDestination(FromByteArray(destination, destinationLength));
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        decoder->error = to_jpegls_errc();
+        return decoder->error;
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_push_decoder_set_line_sink(charls_jpegls_push_decoder* decoder, charls_jpegls_line_sink lineSink, void* context)
+{
+    if (!decoder || !lineSink)
+        return jpegls_errc::invalid_argument;
+
+    if (decoder->error != jpegls_errc::success)
+        return decoder->error;
+
+    if (decoder->reader.IsDecodingStarted())
+        return jpegls_errc::invalid_argument;
+
+    try
+    {
+        decoder->lineSink = std::make_unique<LineSinkBuffer>(lineSink, context, decoder->reader.GetMetadata());
+        decoder->reader.SetDestination({decoder->lineSink.get(), nullptr, 0});
+
+        return jpegls_errc::success;
+    }
+    catch (...)
+    {
+        decoder->error = to_jpegls_errc();
+        return decoder->error;
+    }
+}
+
+
+jpegls_errc CHARLS_API_CALLING_CONVENTION
+charls_jpegls_push_decoder_get_line_count(const charls_jpegls_push_decoder* decoder, size_t* lineCount)
+{
+    if (!decoder || !lineCount)
+        return jpegls_errc::invalid_argument;
+
+    *lineCount = decoder->reader.GetLineCount();
+    return decoder->error;
+}
+
 }
@@ -2,10 +2,9 @@
 
 #pragma once
 
-#include <memory>
+#include <charls/public_types.h>
 
-struct JlsParameters;
-struct JpegLSPresetCodingParameters;
+#include <memory>
 
 namespace charls
 {
@@ -20,4 +19,18 @@ private:
     std::unique_ptr<Strategy> CreateOptimizedCodec(const JlsParameters& params);
 };
 
+
+// Keeps the last created codec, with its lookup tables and buffers, and reuses it for scans with the same parameters.
+template<typename Strategy>
+class JlsCodecCache final
+{
+public:
+    Strategy& GetCodec(const JlsParameters& params, const JpegLSPresetCodingParameters& presets);
+
+private:
+    std::unique_ptr<Strategy> codec_;
+    JlsParameters params_{};
+    JpegLSPresetCodingParameters presets_{};
+};
+
 } // namespace charls
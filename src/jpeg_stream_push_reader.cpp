@@ -0,0 +1,236 @@
+// Copyright (c) Team CharLS. All rights reserved. See the accompanying "LICENSE.md" for licensed use.
+
+#include "jpeg_stream_push_reader.h"
+
+#include "decoder_strategy.h"
+#include "jpeg_marker_code.h"
+#include "util.h"
+
+#include <algorithm>
+
+using namespace charls;
+
+namespace
+{
+
+// The bit reader looks back a few bytes (GetCurBytePos) from its position: these bytes are kept when decoded bytes are discarded.
+constexpr size_t BytesKeptBeforePosition = 16;
+
+
+bool IsRestartMarker(uint8_t markerCode) noexcept
+{
+    return markerCode >= static_cast<uint8_t>(JpegMarkerCode::Restart0) && markerCode < static_cast<uint8_t>(JpegMarkerCode::Restart0) + 8;
+}
+
+
+// Returns true when the marker segments up to and including the next SOS segment have been received.
+// Bytes that are not a valid marker end the search: the reader reports them as an error.
+bool IsStartOfScanReceived(const uint8_t* position, const uint8_t* end) noexcept
+{
+    while (position != end)
+    {
+        if (*position != JpegMarkerStartByte)
+            return true;
+
+        // Skip optional 0xFF fill bytes (see T.81, B.1.1.2).
+        while (position != end && *position == JpegMarkerStartByte)
+        {
+            ++position;
+        }
+
+        if (position == end)
+            return false;
+
+        const uint8_t markerCode = *position++;
+        if (markerCode == static_cast<uint8_t>(JpegMarkerCode::StartOfImage))
+            continue;
+
+        if (markerCode == static_cast<uint8_t>(JpegMarkerCode::EndOfImage) || IsRestartMarker(markerCode))
+            return true;
+
+        if (end - position < 2)
+            return false;
+
+        const size_t segmentSize = static_cast<size_t>(position[0]) << 8 | position[1];
+        if (static_cast<size_t>(end - position) < segmentSize)
+            return false;
+
+        position += segmentSize;
+        if (markerCode == static_cast<uint8_t>(JpegMarkerCode::StartOfScan))
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace
+
+namespace charls
+{
+
+void JpegStreamPushReader::Feed(const uint8_t* source, size_t count)
+{
+    if (state_ == State::Done)
+        return;
+
+    // The codec position is kept as an offset: the bytes move when decoded bytes are discarded or the buffer grows.
+    size_t codecPosition = state_ == State::Lines ? static_cast<size_t>(codec_->GetPosition() - input_.data()) : 0;
+
+    const size_t decodedBytes = state_ == State::Lines ? codecPosition - std::min(codecPosition, BytesKeptBeforePosition) : readPosition_;
+    if (decodedBytes != 0 && decodedBytes >= input_.size() / 2)
+    {
+        input_.erase(input_.begin(), input_.begin() + static_cast<std::ptrdiff_t>(decodedBytes));
+        codecPosition -= std::min(codecPosition, decodedBytes);
+        readPosition_ -= std::min(readPosition_, decodedBytes);
+        markerSearchPosition_ -= std::min(markerSearchPosition_, decodedBytes);
+    }
+
+    input_.insert(input_.end(), source, source + count);
+
+    if (state_ == State::Lines)
+    {
+        codec_->SetPosition(input_.data() + codecPosition, input_.data() + input_.size());
+    }
+
+    Decode();
+}
+
+
+void JpegStreamPushReader::SetDestination(ByteStreamInfo destination)
+{
+    if (IsHeaderRead())
+    {
+        reader_.PrepareRead(destination);
+    }
+
+    destination_ = destination;
+    Decode();
+}
+
+
+void JpegStreamPushReader::Decode()
+{
+    for (;;)
+    {
+        switch (state_)
+        {
+        case State::Header:
+        case State::StartOfScan:
+            if (!TryReadStartOfScan())
+                return;
+            break;
+
+        case State::Scan:
+        {
+            if ((!destination_.rawData && !destination_.rawStream) || (input_.size() - readPosition_ < maximumLineSize_ && !IsScanEndReceived()))
+                return;
+
+            const JlsParameters& params = reader_.GetMetadata();
+            const size_t bytesPerPlane = reader_.PrepareRead(destination_);
+            ByteStreamInfo destination = destination_;
+            SkipBytes(destination, bytesPerPlane * componentIndex_);
+
+            codec_ = &codecCache_.GetCodec(params, params.custom);
+            std::unique_ptr<ProcessLine> processLine(codec_->CreateProcess(destination));
+            ByteStreamInfo compressedData = FromByteArray(input_.data() + readPosition_, input_.size() - readPosition_);
+            codec_->StartDecodeScan(move(processLine), {0, 0, params.width, params.height}, compressedData);
+            scanLine_ = 0;
+            state_ = State::Lines;
+            break;
+        }
+
+        case State::Lines:
+        {
+            const JlsParameters& params = reader_.GetMetadata();
+            while (scanLine_ < params.height &&
+                   (static_cast<size_t>(input_.data() + input_.size() - codec_->GetPosition()) >= maximumLineSize_ || IsScanEndReceived()))
+            {
+                codec_->DecodeLine();
+                ++scanLine_;
+                ++lineCount_;
+            }
+
+            // The end of the scan is checked with the marker that follows it.
+            if (scanLine_ < params.height || !IsScanEndReceived())
+                return;
+
+            codec_->EndScan();
+            readPosition_ = static_cast<size_t>(codec_->GetCurBytePos() - input_.data());
+
+            ++componentIndex_;
+            state_ = params.interleaveMode == InterleaveMode::None && componentIndex_ < params.components ? State::StartOfScan : State::Done;
+            break;
+        }
+
+        case State::Done:
+            input_.clear();
+            input_.shrink_to_fit();
+            return;
+        }
+    }
+}
+
+
+bool JpegStreamPushReader::TryReadStartOfScan()
+{
+    if (!IsStartOfScanReceived(input_.data() + readPosition_, input_.data() + input_.size()))
+        return false;
+
+    reader_.SetSource(FromByteArray(input_.data() + readPosition_, input_.size() - readPosition_));
+    if (state_ == State::Header)
+    {
+        reader_.ReadHeader();
+    }
+    reader_.ReadStartOfScan(state_ == State::Header);
+    readPosition_ = input_.size() - reader_.GetSource().count;
+    reader_.SetSource({});
+
+    // A sample is encoded with at most LIMIT bits (see ITU-T.87, A.5.2), a run interruption adds at most 16 bits.
+    // A bit is stuffed after every 0xFF byte: a line needs at most 8 bytes for every 7 bytes of encoded bits.
+    // The extra bytes are for a restart marker and the bytes that the bit reader loads in advance.
+    const JlsParameters& params = reader_.GetMetadata();
+    const size_t limit = static_cast<size_t>(2) * (params.bitsPerSample + std::max(8, params.bitsPerSample)) + 16;
+    const size_t samplesPerLine = static_cast<size_t>(params.width) * (params.interleaveMode == InterleaveMode::None ? 1 : params.components);
+    maximumLineSize_ = samplesPerLine * limit / 7 + 64;
+
+    markerSearchPosition_ = readPosition_;
+    scanEndReceived_ = false;
+    state_ = State::Scan;
+    return true;
+}
+
+
+// Inside encoded data a 0xFF byte is always followed by a value < 0x80 (see ITU-T.87, A.1): the first other marker, that is
+// not a RSTm marker, ends the scan. Once it has been received all remaining lines of the scan can be decoded.
+bool JpegStreamPushReader::IsScanEndReceived() noexcept
+{
+    if (scanEndReceived_)
+        return true;
+
+    const uint8_t* const end = input_.data() + input_.size();
+    const uint8_t* position = input_.data() + markerSearchPosition_;
+    for (;;)
+    {
+        position = std::find(position, end, JpegMarkerStartByte);
+        const uint8_t* markerStart = position;
+
+        while (position != end && *position == JpegMarkerStartByte)
+        {
+            ++position;
+        }
+
+        if (position == end)
+        {
+            markerSearchPosition_ = static_cast<size_t>(markerStart - input_.data());
+            return false;
+        }
+
+        if (*position >= 0x80 && !IsRestartMarker(*position))
+        {
+            scanEndReceived_ = true;
+            return true;
+        }
+    }
+}
+
+} // namespace charls
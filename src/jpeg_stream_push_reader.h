@@ -0,0 +1,80 @@
+// Copyright (c) Team CharLS. All rights reserved. See the accompanying "LICENSE.md" for licensed use.
+
+#pragma once
+
+#include "jpeg_stream_reader.h"
+#include "jls_codec_factory.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace charls
+{
+
+class DecoderStrategy;
+
+// Purpose: decodes a JPEG-LS byte stream that is received in parts, without waiting for data that has not arrived yet.
+// The received bytes are kept until they have been decoded. A line is only decoded when the bytes that it can
+// need at most have been received, or when the end of its scan has been received: decoding never runs out of data.
+class JpegStreamPushReader final
+{
+public:
+    // Adds received bytes and decodes as much as possible.
+    void Feed(const uint8_t* source, size_t count);
+
+    // Sets the destination (a byte array or a stream) of the decoded pixels, no lines are decoded before it is set.
+    void SetDestination(ByteStreamInfo destination);
+
+    bool IsHeaderRead() const noexcept
+    {
+        return state_ != State::Header;
+    }
+
+    bool IsDecodingStarted() const noexcept
+    {
+        return state_ == State::Lines || state_ == State::Done || componentIndex_ != 0;
+    }
+
+    const JlsParameters& GetMetadata() const noexcept
+    {
+        return reader_.GetMetadata();
+    }
+
+    // Number of decoded lines (of all scans when the components are not interleaved).
+    size_t GetLineCount() const noexcept
+    {
+        return lineCount_;
+    }
+
+private:
+    enum class State
+    {
+        Header,
+        StartOfScan,
+        Scan,
+        Lines,
+        Done
+    };
+
+    void Decode();
+    bool TryReadStartOfScan();
+    bool IsScanEndReceived() noexcept;
+
+    std::vector<uint8_t> input_;
+    size_t readPosition_{}; // first byte that has not been read, while no scan is being decoded
+    size_t markerSearchPosition_{};
+    bool scanEndReceived_{};
+
+    JpegStreamReader reader_{{}};
+    State state_{State::Header};
+    ByteStreamInfo destination_{};
+    int32_t componentIndex_{};
+    int32_t scanLine_{};
+    size_t lineCount_{};
+    size_t maximumLineSize_{};
+
+    JlsCodecCache<DecoderStrategy> codecCache_;
+    DecoderStrategy* codec_{};
+};
+
+} // namespace charls
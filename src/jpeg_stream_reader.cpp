@@ -8,6 +8,7 @@
 #include "jls_codec_factory.h"
 #include "jpeg_marker_code.h"
 #include "jpegls_preset_parameters_type.h"
+#include "parallel_for.h"
 #include "util.h"
 
 #include <algorithm>
@@ -28,12 +29,8 @@ void CheckParameterCoherent(const JlsParameters& params)
 {
     switch (params.components)
     {
-    case 4:
-        if (params.interleaveMode == InterleaveMode::Sample)
-            throw jpegls_error{jpegls_errc::parameter_value_not_supported};
-
-        break;
     case 3:
+    case 4:
         break;
     default:
         if (params.interleaveMode != InterleaveMode::None)
@@ -43,6 +40,49 @@ void CheckParameterCoherent(const JlsParameters& params)
     }
 }
 
+
+// Returns the start of every restart interval in the encoded data of a scan, followed by the position of the marker that ends the scan.
+// Inside encoded data a 0xFF byte is always followed by a value < 0x80 (see ITU-T.87, A.1), which makes it possible to locate the markers without decoding.
+vector<uint8_t*> FindRestartIntervals(uint8_t* position, uint8_t* end, size_t intervalCount)
+{
+    vector<uint8_t*> intervals{position};
+    int32_t restartIndex{};
+
+    for (;;)
+    {
+        position = find(position, end, JpegMarkerStartByte);
+        uint8_t* markerStart = position;
+
+        // Skip optional 0xFF fill bytes (see T.81, B.1.1.2).
+        while (position != end && *position == JpegMarkerStartByte)
+        {
+            ++position;
+        }
+
+        if (position == end)
+        {
+            intervals.push_back(end);
+            return intervals;
+        }
+
+        if (*position < 0x80)
+            continue;
+
+        if (intervals.size() == intervalCount)
+        {
+            intervals.push_back(markerStart);
+            return intervals;
+        }
+
+        if (*position != static_cast<int32_t>(JpegMarkerCode::Restart0) + restartIndex)
+            throw jpegls_error{jpegls_errc::restart_marker_not_found};
+
+        ++position;
+        intervals.push_back(position);
+        restartIndex = (restartIndex + 1) % 8;
+    }
+}
+
 } // namespace
 
 namespace charls
@@ -56,6 +96,39 @@ JpegStreamReader::JpegStreamReader(ByteStreamInfo byteStreamInfo) noexcept
 void JpegStreamReader::Read(ByteStreamInfo rawPixels)
 {
     ReadHeader();
+    const size_t bytesPerPlane = PrepareRead(rawPixels);
+
+    if (params_.threadCount > 1 && rawPixels.rawData && byteStream_.rawData)
+    {
+        ReadConcurrently(rawPixels, bytesPerPlane);
+        return;
+    }
+
+    // The scans of the components have the same parameters in most cases and can be decoded with the same codec.
+    JlsCodecCache<DecoderStrategy> localCodecCache;
+    JlsCodecCache<DecoderStrategy>& codecCache = codecCache_ ? *codecCache_ : localCodecCache;
+    int componentIndex{};
+
+    while (componentIndex < params_.components)
+    {
+        ReadStartOfScan(componentIndex == 0);
+
+        DecoderStrategy& codec = codecCache.GetCodec(params_, params_.custom);
+        std::unique_ptr<ProcessLine> processLine(codec.CreateProcess(rawPixels));
+        codec.DecodeScan(move(processLine), rect_, byteStream_);
+        SkipBytes(rawPixels, bytesPerPlane);
+
+        if (params_.interleaveMode != InterleaveMode::None)
+            return;
+
+        componentIndex += 1;
+    }
+}
+
+
+// Checks the parameters of the header and the size of the destination, returns the number of bytes of a component plane.
+size_t JpegStreamReader::PrepareRead(ByteStreamInfo rawPixels)
+{
     CheckParameterCoherent(params_);
 
     if (rect_.Width <= 0)
@@ -69,22 +142,69 @@ void JpegStreamReader::Read(ByteStreamInfo rawPixels)
     if (rawPixels.rawData && static_cast<int64_t>(rawPixels.count) < bytesPerPlane * params_.components)
         throw jpegls_error{jpegls_errc::destination_buffer_too_small};
 
-    int componentIndex{};
+    return static_cast<size_t>(bytesPerPlane);
+}
 
-    while (componentIndex < params_.components)
+
+// Locates the scans (one per component when the interleave mode is None) and their restart intervals first.
+// These are independent of each other and are decoded concurrently, each one directly into its own part of the destination.
+void JpegStreamReader::ReadConcurrently(ByteStreamInfo rawPixels, size_t bytesPerPlane)
+{
+    struct Interval
+    {
+        JlsParameters params;
+        JlsRect rect;
+        ByteStreamInfo compressedData;
+        ByteStreamInfo destination;
+    };
+
+    uint8_t* const end = byteStream_.rawData + byteStream_.count;
+    vector<Interval> intervals;
+
+    for (int componentIndex = 0; componentIndex < params_.components; ++componentIndex)
     {
         ReadStartOfScan(componentIndex == 0);
 
-        std::unique_ptr<DecoderStrategy> codec = JlsCodecFactory<DecoderStrategy>().CreateCodec(params_, params_.custom);
-        std::unique_ptr<ProcessLine> processLine(codec->CreateProcess(rawPixels));
-        codec->DecodeScan(move(processLine), rect_, byteStream_);
-        SkipBytes(rawPixels, static_cast<size_t>(bytesPerPlane));
+        const int32_t restartInterval = params_.restartInterval != 0 ? params_.restartInterval : params_.height;
+        const size_t intervalCount = static_cast<size_t>((params_.height + restartInterval - 1) / restartInterval);
+        const vector<uint8_t*> starts = FindRestartIntervals(byteStream_.rawData, end, intervalCount);
 
-        if (params_.interleaveMode != InterleaveMode::None)
-            return;
+        // Encoded data that ends too early has less restart intervals than the scan needs.
+        if (starts.size() != intervalCount + 1)
+            throw jpegls_error{jpegls_errc::source_buffer_too_small};
 
-        componentIndex += 1;
+        for (size_t index = 0; index < intervalCount; ++index)
+        {
+            const int32_t firstLine = static_cast<int32_t>(index) * restartInterval;
+            const int32_t lineCount = std::min(restartInterval, params_.height - firstLine);
+            if (firstLine + lineCount <= rect_.Y || firstLine >= rect_.Y + rect_.Height)
+                continue; // Interval is outside the requested rectangle.
+
+            Interval interval{params_, {rect_.X, rect_.Y - firstLine, rect_.Width, rect_.Height}, {}, rawPixels};
+            interval.params.height = lineCount;
+            interval.params.restartInterval = 0;
+            SkipBytes(interval.destination, static_cast<size_t>(std::max(0, firstLine - rect_.Y)) * params_.stride);
+
+            // The last interval gets all remaining bytes, to detect missing or too much encoded data like a single codec would do.
+            uint8_t* const intervalEnd = index + 1 == intervalCount ? end : starts[index + 1];
+            interval.compressedData = {nullptr, starts[index], static_cast<size_t>(intervalEnd - starts[index])};
+
+            intervals.push_back(interval);
+        }
+
+        SkipBytes(byteStream_, static_cast<size_t>(starts.back() - byteStream_.rawData));
+        SkipBytes(rawPixels, bytesPerPlane);
+
+        if (params_.interleaveMode != InterleaveMode::None)
+            break;
     }
+
+    ParallelFor(intervals.size(), params_.threadCount, [&intervals, this](size_t index) {
+        Interval& interval = intervals[index];
+        std::unique_ptr<DecoderStrategy> codec = JlsCodecFactory<DecoderStrategy>().CreateCodec(interval.params, params_.custom);
+        std::unique_ptr<ProcessLine> processLine(codec->CreateProcess(interval.destination));
+        codec->DecodeScan(move(processLine), interval.rect, interval.compressedData);
+    });
 }
 
 
@@ -99,6 +219,9 @@ void JpegStreamReader::ReadNBytes(std::vector<char>& destination, int byteCount)
 
 void JpegStreamReader::ReadHeader()
 {
+    // A restart interval is only active when the stream defines one.
+    params_.restartInterval = 0;
+
     if (ReadNextMarkerCode() != JpegMarkerCode::StartOfImage)
         throw jpegls_error{jpegls_errc::start_of_image_marker_not_found};
 
@@ -150,6 +273,7 @@ void JpegStreamReader::ValidateMarkerCode(JpegMarkerCode markerCode) const
     case JpegMarkerCode::StartOfFrameJpegLS:
     case JpegMarkerCode::JpegLSPresetParameters:
     case JpegMarkerCode::StartOfScan:
+    case JpegMarkerCode::DefineRestartInterval:
     case JpegMarkerCode::Comment:
     case JpegMarkerCode::ApplicationData0:
     case JpegMarkerCode::ApplicationData1:
@@ -188,8 +312,16 @@ void JpegStreamReader::ValidateMarkerCode(JpegMarkerCode markerCode) const
 
     case JpegMarkerCode::EndOfImage:
         throw jpegls_error{jpegls_errc::unexpected_end_of_image_marker};
+
+    case JpegMarkerCode::Restart0: // RSTm markers are only valid inside the encoded data of a scan.
+        throw jpegls_error{jpegls_errc::restart_marker_not_found};
     }
 
+    // RST1 - RST7 have no enumerator of their own.
+    const int32_t restartIndex = static_cast<int32_t>(markerCode) - static_cast<int32_t>(JpegMarkerCode::Restart0);
+    if (restartIndex > 0 && restartIndex < 8)
+        throw jpegls_error{jpegls_errc::restart_marker_not_found};
+
     throw jpegls_error{jpegls_errc::unknown_jpeg_marker_found};
 }
 
@@ -207,6 +339,9 @@ int JpegStreamReader::ReadMarkerSegment(JpegMarkerCode markerCode, int32_t segme
     case JpegMarkerCode::JpegLSPresetParameters:
         return ReadPresetParametersSegment(segmentSize);
 
+    case JpegMarkerCode::DefineRestartInterval:
+        return ReadDefineRestartIntervalSegment(segmentSize);
+
     case JpegMarkerCode::ApplicationData0:
     case JpegMarkerCode::ApplicationData1:
     case JpegMarkerCode::ApplicationData2:
@@ -227,7 +362,7 @@ int JpegStreamReader::ReadMarkerSegment(JpegMarkerCode markerCode, int32_t segme
     case JpegMarkerCode::ApplicationData8:
         return TryReadHPColorTransformSegment(segmentSize);
 
-    // Other tags not supported (among which DNL DRI)
+    // Other tags not supported (among which DNL)
     default:
         ASSERT(false);
         return 0;
@@ -327,11 +462,40 @@ int JpegStreamReader::ReadPresetParametersSegment(int32_t segmentSize)
 }
 
 
+int JpegStreamReader::ReadDefineRestartIntervalSegment(int32_t segmentSize)
+{
+    // Note: ISO/IEC 14495-1, C.2.5 extends the DRI segment of ISO/IEC 10918-1, B.2.4.4 to allow a 2, 3 or 4 byte Ri.
+    if (segmentSize < 2 || segmentSize > 4)
+        throw jpegls_error{jpegls_errc::invalid_marker_segment_size};
+
+    uint32_t restartInterval{};
+    for (int i = 0; i < segmentSize; ++i)
+    {
+        restartInterval = (restartInterval << 8) | ReadByte();
+    }
+
+    if (restartInterval > INT32_MAX)
+        throw jpegls_error{jpegls_errc::parameter_value_not_supported};
+
+    params_.restartInterval = static_cast<int32_t>(restartInterval);
+    return segmentSize;
+}
+
+
 void JpegStreamReader::ReadStartOfScan(bool firstComponent)
 {
     if (!firstComponent)
     {
-        const JpegMarkerCode markerCode = ReadNextMarkerCode();
+        JpegMarkerCode markerCode = ReadNextMarkerCode();
+
+        // A DRI segment may redefine the restart interval before every scan.
+        while (markerCode == JpegMarkerCode::DefineRestartInterval)
+        {
+            const int32_t segmentSize = ReadSegmentSize();
+            ReadDefineRestartIntervalSegment(segmentSize - 2);
+            markerCode = ReadNextMarkerCode();
+        }
+
         if (markerCode != JpegMarkerCode::StartOfScan)
             throw jpegls_error{jpegls_errc::invalid_encoded_data}; // TODO: throw more specific error code.
     }
@@ -438,9 +602,13 @@ int JpegStreamReader::TryReadHPColorTransformSegment(int32_t segmentSize)
     if (segmentSize < 5)
         return 0;
 
-    vector<char> sourceTag;
-    ReadNBytes(sourceTag, 4);
-    if (strncmp(sourceTag.data(), "mrfx", 4) != 0)
+    // All 4 bytes of the source tag are read, also when an earlier byte differs.
+    bool isHPSourceTag = true;
+    for (const uint8_t expected : {'m', 'r', 'f', 'x'})
+    {
+        isHPSourceTag = ReadByte() == expected && isHPSourceTag;
+    }
+    if (!isHPSourceTag)
         return 4;
 
     const auto colorTransformation = ReadByte();
@@ -465,10 +633,10 @@ int JpegStreamReader::TryReadHPColorTransformSegment(int32_t segmentSize)
 
 void JpegStreamReader::AddComponent(uint8_t componentId)
 {
-    if (find(componentIds_.cbegin(), componentIds_.cend(), componentId) != componentIds_.cend())
+    if (componentIds_[componentId])
         throw jpegls_error{jpegls_errc::duplicate_component_id_in_sof_segment};
 
-    componentIds_.push_back(componentId);
+    componentIds_.set(componentId);
 }
 
 
@@ -4,6 +4,7 @@
 
 #include <charls/public_types.h>
 
+#include <bitset>
 #include <cstdint>
 #include <vector>
 
@@ -11,6 +12,8 @@ namespace charls
 {
 
 enum class JpegMarkerCode : uint8_t;
+class DecoderStrategy;
+template<typename Strategy> class JlsCodecCache;
 
 // Purpose: minimal implementation to read a JPEG byte stream.
 class JpegStreamReader final
@@ -30,6 +33,18 @@ public:
 
     void Read(ByteStreamInfo rawPixels);
     void ReadHeader();
+    size_t PrepareRead(ByteStreamInfo rawPixels);
+
+    // The bytes that have not been read yet.
+    ByteStreamInfo GetSource() const noexcept
+    {
+        return byteStream_;
+    }
+
+    void SetSource(ByteStreamInfo source) noexcept
+    {
+        byteStream_ = source;
+    }
 
     void SetInfo(const JlsParameters& params) noexcept
     {
@@ -41,10 +56,17 @@ public:
         rect_ = rect;
     }
 
+    // The codecs of the cache are reused by Read, when it is decoding on a single thread.
+    void SetCodecCache(JlsCodecCache<DecoderStrategy>* codecCache) noexcept
+    {
+        codecCache_ = codecCache;
+    }
+
     void ReadStartOfScan(bool firstComponent);
     uint8_t ReadByte();
 
 private:
+    void ReadConcurrently(ByteStreamInfo rawPixels, size_t bytesPerPlane);
     void SkipByte();
     int ReadUInt16();
     int32_t ReadSegmentSize();
@@ -56,6 +78,7 @@ private:
     int ReadStartOfFrameSegment(int32_t segmentSize);
     static int ReadComment() noexcept;
     int ReadPresetParametersSegment(int32_t segmentSize);
+    int ReadDefineRestartIntervalSegment(int32_t segmentSize);
     void ReadJfif();
     int TryReadHPColorTransformSegment(int32_t segmentSize);
     void AddComponent(uint8_t componentId);
@@ -63,7 +86,8 @@ private:
     ByteStreamInfo byteStream_;
     JlsParameters params_{};
     JlsRect rect_{};
-    std::vector<uint8_t> componentIds_;
+    std::bitset<256> componentIds_;
+    JlsCodecCache<DecoderStrategy>* codecCache_{};
 };
 
 } // namespace charls
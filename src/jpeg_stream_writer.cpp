@@ -10,10 +10,9 @@
 
 #include <array>
 #include <cassert>
-#include <vector>
+#include <cstring>
 
 using std::array;
-using std::vector;
 
 namespace charls
 {
@@ -50,25 +49,21 @@ void JpegStreamWriter::WriteJpegFileInterchangeFormatSegment(const JfifParameter
     ASSERT(params.Ythumbnail >= 0 && params.Ythumbnail < 256);
 
     // Create a JPEG APP0 segment in the JPEG File Interchange Format (JFIF), v1.02
-    vector<uint8_t> segment{'J', 'F', 'I', 'F', '\0'};
-    push_back(segment, static_cast<uint16_t>(params.version));
-    segment.push_back(static_cast<uint8_t>(params.units));
-    push_back(segment, static_cast<uint16_t>(params.Xdensity));
-    push_back(segment, static_cast<uint16_t>(params.Ydensity));
+    const size_t thumbnailSize = params.Xthumbnail > 0 ? static_cast<size_t>(3) * params.Xthumbnail * params.Ythumbnail : 0;
+    if (thumbnailSize != 0 && params.thumbnail)
+        throw jpegls_error{jpegls_errc::invalid_argument_thumbnail};
 
-    // thumbnail
-    segment.push_back(static_cast<uint8_t>(params.Xthumbnail));
-    segment.push_back(static_cast<uint8_t>(params.Ythumbnail));
-    if (params.Xthumbnail > 0)
-    {
-        if (params.thumbnail)
-            throw jpegls_error{jpegls_errc::invalid_argument_thumbnail};
+    WriteSegmentHeader(JpegMarkerCode::ApplicationData0, 14 + thumbnailSize);
+    WriteBytes("JFIF", 5);
+    WriteUInt16(static_cast<uint16_t>(params.version));
+    WriteByte(static_cast<uint8_t>(params.units));
+    WriteUInt16(static_cast<uint16_t>(params.Xdensity));
+    WriteUInt16(static_cast<uint16_t>(params.Ydensity));
 
-        segment.insert(segment.end(), static_cast<uint8_t*>(params.thumbnail),
-                       static_cast<uint8_t*>(params.thumbnail) + static_cast<size_t>(3) * params.Xthumbnail * params.Ythumbnail);
-    }
-
-    WriteSegment(JpegMarkerCode::ApplicationData0, segment.data(), segment.size());
+    // thumbnail
+    WriteByte(static_cast<uint8_t>(params.Xthumbnail));
+    WriteByte(static_cast<uint8_t>(params.Ythumbnail));
+    WriteBytes(params.thumbnail, thumbnailSize);
 }
 
 
@@ -80,25 +75,23 @@ void JpegStreamWriter::WriteStartOfFrameSegment(int width, int height, int bitsP
     ASSERT(componentCount > 0 && componentCount <= UINT8_MAX);
 
     // Create a Frame Header as defined in ISO/IEC 14495-1, C.2.2 and T.81, B.2.2
-    vector<uint8_t> segment;
-    segment.push_back(static_cast<uint8_t>(bitsPerSample)); // P = Sample precision
-    push_back(segment, static_cast<uint16_t>(height));      // Y = Number of lines
-    push_back(segment, static_cast<uint16_t>(width));       // X = Number of samples per line
+    WriteSegmentHeader(JpegMarkerCode::StartOfFrameJpegLS, 6 + static_cast<size_t>(3) * componentCount);
+    WriteByte(static_cast<uint8_t>(bitsPerSample)); // P = Sample precision
+    WriteUInt16(static_cast<uint16_t>(height));     // Y = Number of lines
+    WriteUInt16(static_cast<uint16_t>(width));      // X = Number of samples per line
 
     // Components
-    segment.push_back(static_cast<uint8_t>(componentCount)); // Nf = Number of image components in frame
+    WriteByte(static_cast<uint8_t>(componentCount)); // Nf = Number of image components in frame
 
     // Use by default 1 as the start component identifier to remain compatible with the
     // code sample of ISO/IEC 14495-1, H.4 and the JPEG-LS ISO conformance sample files.
     for (auto componentId = 1; componentId <= componentCount; ++componentId)
     {
         // Component Specification parameters
-        segment.push_back(static_cast<uint8_t>(componentId)); // Ci = Component identifier
-        segment.push_back(0x11);                              // Hi + Vi = Horizontal sampling factor + Vertical sampling factor
-        segment.push_back(0);                                 // Tqi = Quantization table destination selector (reserved for JPEG-LS, should be set to 0)
+        WriteByte(static_cast<uint8_t>(componentId)); // Ci = Component identifier
+        WriteByte(0x11);                              // Hi + Vi = Horizontal sampling factor + Vertical sampling factor
+        WriteByte(0);                                 // Tqi = Quantization table destination selector (reserved for JPEG-LS, should be set to 0)
     }
-
-    WriteSegment(JpegMarkerCode::StartOfFrameJpegLS, segment.data(), segment.size());
 }
 
 
@@ -111,17 +104,15 @@ void JpegStreamWriter::WriteColorTransformSegment(ColorTransformation transforma
 
 void JpegStreamWriter::WriteJpegLSPresetParametersSegment(const JpegLSPresetCodingParameters& params)
 {
-    vector<uint8_t> segment;
-
-    segment.push_back(static_cast<uint8_t>(JpegLSPresetParametersType::PresetCodingParameters));
+    WriteSegmentHeader(JpegMarkerCode::JpegLSPresetParameters, 11);
 
-    push_back(segment, static_cast<uint16_t>(params.MaximumSampleValue));
-    push_back(segment, static_cast<uint16_t>(params.Threshold1));
-    push_back(segment, static_cast<uint16_t>(params.Threshold2));
-    push_back(segment, static_cast<uint16_t>(params.Threshold3));
-    push_back(segment, static_cast<uint16_t>(params.ResetValue));
+    WriteByte(static_cast<uint8_t>(JpegLSPresetParametersType::PresetCodingParameters));
 
-    WriteSegment(JpegMarkerCode::JpegLSPresetParameters, segment.data(), segment.size());
+    WriteUInt16(static_cast<uint16_t>(params.MaximumSampleValue));
+    WriteUInt16(static_cast<uint16_t>(params.Threshold1));
+    WriteUInt16(static_cast<uint16_t>(params.Threshold2));
+    WriteUInt16(static_cast<uint16_t>(params.Threshold3));
+    WriteUInt16(static_cast<uint16_t>(params.ResetValue));
 }
 
 
@@ -134,31 +125,78 @@ void JpegStreamWriter::WriteStartOfScanSegment(int componentCount, int allowedLo
            interleaveMode == InterleaveMode::Sample);
 
     // Create a Scan Header as defined in T.87, C.2.3 and T.81, B.2.3
-    vector<uint8_t> segment;
+    WriteSegmentHeader(JpegMarkerCode::StartOfScan, 4 + static_cast<size_t>(2) * componentCount);
 
-    segment.push_back(static_cast<uint8_t>(componentCount));
+    WriteByte(static_cast<uint8_t>(componentCount));
     for (auto i = 0; i < componentCount; ++i)
     {
-        segment.push_back(static_cast<uint8_t>(componentId_));
+        WriteByte(static_cast<uint8_t>(componentId_));
         componentId_++;
-        segment.push_back(0); // Mapping table selector (0 = no table)
+        WriteByte(0); // Mapping table selector (0 = no table)
+    }
+
+    WriteByte(static_cast<uint8_t>(allowedLossyError)); // NEAR parameter
+    WriteByte(static_cast<uint8_t>(interleaveMode));    // ILV parameter
+    WriteByte(0);                                       // transformation
+}
+
+
+void JpegStreamWriter::WriteDefineRestartIntervalSegment(int32_t restartInterval)
+{
+    ASSERT(restartInterval > 0 && restartInterval <= UINT16_MAX);
+
+    // Create a Define Restart Interval segment as defined in T.87, C.2.5 and T.81, B.2.4.4
+    // The 2 byte form of Ri is always sufficient as the restart interval cannot exceed the height.
+    WriteSegmentHeader(JpegMarkerCode::DefineRestartInterval, 2);
+    WriteUInt16(static_cast<uint16_t>(restartInterval));
+}
+
+
+void JpegStreamWriter::WriteEncodedData(const void* data, size_t dataSize)
+{
+    WriteBytes(data, dataSize);
+}
+
+
+void JpegStreamWriter::WriteBytes(const void* data, size_t dataSize)
+{
+    if (destination_.rawStream)
+    {
+        if (static_cast<size_t>(destination_.rawStream->sputn(static_cast<const char*>(data), static_cast<std::streamsize>(dataSize))) != dataSize)
+            throw jpegls_error{jpegls_errc::destination_buffer_too_small};
+
+        return;
     }
 
-    segment.push_back(static_cast<uint8_t>(allowedLossyError)); // NEAR parameter
-    segment.push_back(static_cast<uint8_t>(interleaveMode));    // ILV parameter
-    segment.push_back(0);                                       // transformation
+    if (GetLength() < dataSize)
+        throw jpegls_error{jpegls_errc::destination_buffer_too_small};
+
+    std::memcpy(GetPos(), data, dataSize);
+    byteOffset_ += dataSize;
+}
+
+
+void JpegStreamWriter::WriteRestartMarker(int32_t restartIndex)
+{
+    ASSERT(restartIndex >= 0 && restartIndex < 8);
 
-    WriteSegment(JpegMarkerCode::StartOfScan, segment.data(), segment.size());
+    WriteMarker(static_cast<JpegMarkerCode>(static_cast<int32_t>(JpegMarkerCode::Restart0) + restartIndex));
 }
 
 
 void JpegStreamWriter::WriteSegment(JpegMarkerCode markerCode, const void* data, size_t dataSize)
+{
+    WriteSegmentHeader(markerCode, dataSize);
+    WriteBytes(data, dataSize);
+}
+
+
+void JpegStreamWriter::WriteSegmentHeader(JpegMarkerCode markerCode, size_t dataSize)
 {
     ASSERT(dataSize <= UINT16_MAX - sizeof(uint16_t));
 
     WriteMarker(markerCode);
     WriteUInt16(static_cast<uint16_t>(dataSize + sizeof(uint16_t)));
-    WriteBytes(data, dataSize);
 }
 
 } // namespace charls
@@ -56,6 +56,25 @@ public:
     /// <param name="interleaveMode">The interleave mode of the components.</param>
     void WriteStartOfScanSegment(int componentCount, int allowedLossyError, InterleaveMode interleaveMode);
 
+    /// <summary>
+    /// Writes a JPEG Define Restart Interval (DRI) segment.
+    /// </summary>
+    /// <param name="restartInterval">The number of lines (MCUs) in a restart interval.</param>
+    void WriteDefineRestartIntervalSegment(int32_t restartInterval);
+
+    /// <summary>
+    /// Writes encoded data (the entropy coded segments of a scan) that has been created in a separate buffer.
+    /// </summary>
+    /// <param name="data">The encoded data.</param>
+    /// <param name="dataSize">The size in bytes of the encoded data.</param>
+    void WriteEncodedData(const void* data, size_t dataSize);
+
+    /// <summary>
+    /// Writes a RSTm marker, that separates the restart intervals in the encoded data of a scan.
+    /// </summary>
+    /// <param name="restartIndex">The index m (0 - 7) of the marker.</param>
+    void WriteRestartMarker(int32_t restartIndex);
+
     void WriteEndOfImage();
 
     std::size_t GetBytesWritten() const noexcept
@@ -92,6 +111,9 @@ private:
 
     void WriteSegment(JpegMarkerCode markerCode, const void* data, size_t dataSize);
 
+    // Writes the marker and the length of a segment, the dataSize bytes of the segment are written next.
+    void WriteSegmentHeader(JpegMarkerCode markerCode, size_t dataSize);
+
     void WriteByte(uint8_t value)
     {
         if (destination_.rawStream)
@@ -109,21 +131,11 @@ private:
 
     void WriteBytes(const std::vector<uint8_t>& bytes)
     {
-        for (std::size_t i = 0; i < bytes.size(); ++i)
-        {
-            WriteByte(bytes[i]);
-        }
+        WriteBytes(bytes.data(), bytes.size());
     }
 
-    void WriteBytes(const void* data, const size_t dataSize)
-    {
-        const auto bytes = static_cast<const uint8_t*>(data);
-
-        for (std::size_t i = 0; i < dataSize; ++i)
-        {
-            WriteByte(bytes[i]);
-        }
-    }
+    // Writes the bytes with a single copy or a single call of the stream.
+    void WriteBytes(const void* data, size_t dataSize);
 
     void WriteUInt16(uint16_t value)
     {
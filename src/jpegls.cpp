@@ -10,6 +10,11 @@
 #include "jpegls_preset_coding_parameters.h"
 #include "util.h"
 
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 // As defined in the JPEG-LS standard
@@ -41,26 +46,96 @@ signed char QuantizeGradientOrg(const JpegLSPresetCodingParameters& preset, int3
 }
 
 
-vector<signed char> CreateQLutLossless(int32_t bitCount)
+vector<signed char> CreateQLut(const JpegLSPresetCodingParameters& preset, int32_t NEAR, int32_t range)
 {
-    const JpegLSPresetCodingParameters preset = charls::ComputeDefault((1u << static_cast<uint32_t>(bitCount)) - 1, 0);
-    const int32_t range = preset.MaximumSampleValue + 1;
-
     vector<signed char> lut(static_cast<size_t>(range) * 2);
 
     for (int32_t diff = -range; diff < range; diff++)
     {
-        lut[static_cast<size_t>(range) + diff] = QuantizeGradientOrg(preset, 0,diff);
+        lut[static_cast<size_t>(range) + diff] = QuantizeGradientOrg(preset, NEAR, diff);
     }
     return lut;
 }
 
+
+vector<signed char> CreateQLutLossless(int32_t bitCount)
+{
+    const JpegLSPresetCodingParameters preset = charls::ComputeDefault((1u << static_cast<uint32_t>(bitCount)) - 1, 0);
+    return CreateQLut(preset, 0, preset.MaximumSampleValue + 1);
+}
+
 template<typename Strategy, typename Traits>
 unique_ptr<Strategy> create_codec(const Traits& traits, const JlsParameters& params)
 {
     return make_unique<charls::JlsCodec<Traits, Strategy>>(traits, params);
 }
 
+
+// Creates a codec with traits of which the sample range and the reset value are set at run time.
+template<typename Strategy, typename Traits>
+unique_ptr<Strategy> create_custom_codec(const JlsParameters& params, const JpegLSPresetCodingParameters& presets)
+{
+    Traits traits((1 << params.bitsPerSample) - 1, params.allowedLossyError, presets.ResetValue);
+    traits.MAXVAL = presets.MaximumSampleValue;
+    return create_codec<Strategy>(traits, params);
+}
+
+
+// Creates a codec for custom coding parameters, the pixels of sample interleaved scans are triplets or quads.
+template<typename Strategy, typename SAMPLE>
+unique_ptr<Strategy> create_default_codec(const JlsParameters& params, const JpegLSPresetCodingParameters& presets)
+{
+    if (params.interleaveMode == charls::InterleaveMode::Sample && params.components == 3)
+        return create_custom_codec<Strategy, charls::DefaultTraits<SAMPLE, charls::Triplet<SAMPLE>>>(params, presets);
+
+    if (params.interleaveMode == charls::InterleaveMode::Sample && params.components == 4)
+        return create_custom_codec<Strategy, charls::DefaultTraits<SAMPLE, charls::Quad<SAMPLE>>>(params, presets);
+
+    return create_custom_codec<Strategy, charls::DefaultTraits<SAMPLE, SAMPLE>>(params, presets);
+}
+
+
+// The pixel of a monochrome (or not interleaved) scan is a single sample.
+template<typename T>
+using Sample = T;
+
+
+// Creates a lossless codec of which the sample range is a compile time constant, for every bit count.
+template<typename Strategy, template<typename> class Pixel>
+unique_ptr<Strategy> create_lossless_codec(const JlsParameters& params)
+{
+    switch (params.bitsPerSample)
+    {
+    case  2: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint8_t>, 2>(), params);
+    case  3: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint8_t>, 3>(), params);
+    case  4: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint8_t>, 4>(), params);
+    case  5: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint8_t>, 5>(), params);
+    case  6: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint8_t>, 6>(), params);
+    case  7: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint8_t>, 7>(), params);
+    case  8: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint8_t>, 8>(), params);
+    case  9: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 9>(), params);
+    case 10: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 10>(), params);
+    case 11: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 11>(), params);
+    case 12: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 12>(), params);
+    case 13: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 13>(), params);
+    case 14: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 14>(), params);
+    case 15: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 15>(), params);
+    case 16: return create_codec<Strategy>(charls::LosslessTraits<Pixel<uint16_t>, 16>(), params);
+    default:
+        return nullptr;
+    }
+}
+
+
+// Compares the parameters a codec depends on. The thread count and the JFIF header are not used by a codec.
+bool HaveSameCodingParameters(const JlsParameters& a, const JlsParameters& b) noexcept
+{
+    return a.width == b.width && a.height == b.height && a.bitsPerSample == b.bitsPerSample && a.stride == b.stride &&
+        a.components == b.components && a.allowedLossyError == b.allowedLossyError && a.interleaveMode == b.interleaveMode &&
+        a.colorTransformation == b.colorTransformation && a.outputBgr == b.outputBgr && a.restartInterval == b.restartInterval &&
+        a.outputBufferSize == b.outputBufferSize && charls::IsEqual(a.custom, b.custom);
+}
+
 } // namespace
 
 
@@ -70,7 +145,7 @@ namespace charls
 // Lookup tables to replace code with lookup tables.
 // To avoid threading issues, all tables are created when the program is loaded.
 
-// Lookup table: decode symbols that are smaller or equal to 8 bit (16 tables for each value of k)
+// Lookup table: decode symbols that are smaller or equal to CTable::bit_count bits (16 tables for each value of k)
 CTable decodingTables[16] = { InitTable(0), InitTable(1), InitTable(2), InitTable(3),
                               InitTable(4), InitTable(5), InitTable(6), InitTable(7),
                               InitTable(8), InitTable(9), InitTable(10), InitTable(11),
@@ -83,6 +158,55 @@ vector<signed char> rgquant12Ll = CreateQLutLossless(12);
 vector<signed char> rgquant16Ll = CreateQLutLossless(16);
 
 
+std::shared_ptr<const vector<signed char>> GetQuantizationLut(int32_t bitsPerSample, int32_t near, int32_t t1, int32_t t2, int32_t t3)
+{
+    using Key = std::array<int32_t, 5>;
+    static std::mutex mutex;
+    static std::map<Key, std::weak_ptr<const vector<signed char>>> luts;
+
+    // The most recently used tables are kept alive, also when no codec uses them: one-shot calls one after another
+    // (without a session) don't create the same table again. The other tables are released with their last codec.
+    static std::array<std::shared_ptr<const vector<signed char>>, 4> recentLuts;
+    const auto useRecent = [](const std::shared_ptr<const vector<signed char>>& lut)
+    {
+        auto it = std::find(recentLuts.begin(), recentLuts.end(), lut);
+        if (it == recentLuts.end())
+        {
+            it = recentLuts.end() - 1;
+            *it = lut;
+        }
+        std::rotate(recentLuts.begin(), it, it + 1);
+        return lut;
+    };
+
+    const Key key{bitsPerSample, near, t1, t2, t3};
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        auto lut = luts[key].lock();
+        if (lut)
+            return useRecent(lut);
+    }
+
+    const JpegLSPresetCodingParameters preset{0, t1, t2, t3, 0};
+    auto lut = std::make_shared<const vector<signed char>>(CreateQLut(preset, near, 1 << bitsPerSample));
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = luts.begin(); it != luts.end();)
+    {
+        it = it->second.expired() && it->first != key ? luts.erase(it) : std::next(it);
+    }
+
+    // Another thread may have created the same table in the meantime: all codecs should use a single copy.
+    auto& entry = luts[key];
+    auto existingLut = entry.lock();
+    if (existingLut)
+        return useRecent(existingLut);
+
+    entry = lut;
+    return useRecent(lut);
+}
+
+
 template<typename Strategy>
 unique_ptr<Strategy> JlsCodecFactory<Strategy>::CreateCodec(const JlsParameters& params, const JpegLSPresetCodingParameters& presets)
 {
@@ -97,15 +221,11 @@ unique_ptr<Strategy> JlsCodecFactory<Strategy>::CreateCodec(const JlsParameters&
     {
         if (params.bitsPerSample <= 8)
         {
-            DefaultTraits<uint8_t, uint8_t> traits((1 << params.bitsPerSample) - 1, params.allowedLossyError, presets.ResetValue);
-            traits.MAXVAL = presets.MaximumSampleValue;
-            codec = make_unique<JlsCodec<DefaultTraits<uint8_t, uint8_t>, Strategy>>(traits, params);
+            codec = create_default_codec<Strategy, uint8_t>(params, presets);
         }
         else
         {
-            DefaultTraits<uint16_t, uint16_t> traits((1 << params.bitsPerSample) - 1, params.allowedLossyError, presets.ResetValue);
-            traits.MAXVAL = presets.MaximumSampleValue;
-            codec = make_unique<JlsCodec<DefaultTraits<uint16_t, uint16_t>, Strategy>>(traits, params);
+            codec = create_default_codec<Strategy, uint16_t>(params, presets);
         }
     }
 
@@ -116,7 +236,7 @@ unique_ptr<Strategy> JlsCodecFactory<Strategy>::CreateCodec(const JlsParameters&
 template<typename Strategy>
 unique_ptr<Strategy> JlsCodecFactory<Strategy>::CreateOptimizedCodec(const JlsParameters& params)
 {
-    if (params.interleaveMode == InterleaveMode::Sample && params.components != 3)
+    if (params.interleaveMode == InterleaveMode::Sample && params.components != 3 && params.components != 4)
         return nullptr;
 
 #ifndef DISABLE_SPECIALIZATIONS
@@ -124,22 +244,14 @@ unique_ptr<Strategy> JlsCodecFactory<Strategy>::CreateOptimizedCodec(const JlsPa
     // optimized lossless versions common formats
     if (params.allowedLossyError == 0)
     {
-        if (params.interleaveMode == InterleaveMode::Sample)
-        {
-            if (params.bitsPerSample == 8)
-                return create_codec<Strategy>(LosslessTraits<Triplet<uint8_t>, 8>(), params);
-        }
-        else
-        {
-            switch (params.bitsPerSample)
-            {
-            case  8: return create_codec<Strategy>(LosslessTraits<uint8_t, 8>(), params);
-            case 12: return create_codec<Strategy>(LosslessTraits<uint16_t, 12>(), params);
-            case 16: return create_codec<Strategy>(LosslessTraits<uint16_t, 16>(), params);
-                default:
-                    break;
-            }
-        }
+        if (params.interleaveMode != InterleaveMode::Sample)
+            return create_lossless_codec<Strategy, Sample>(params);
+
+        if (params.components == 3)
+            return create_lossless_codec<Strategy, Triplet>(params);
+
+        if (params.bitsPerSample == 8)
+            return create_codec<Strategy>(LosslessTraits<Quad<uint8_t>, 8>(), params);
     }
 
 #endif
@@ -149,14 +261,18 @@ unique_ptr<Strategy> JlsCodecFactory<Strategy>::CreateOptimizedCodec(const JlsPa
     if (params.bitsPerSample <= 8)
     {
         if (params.interleaveMode == InterleaveMode::Sample)
-            return create_codec<Strategy>(DefaultTraits<uint8_t, Triplet<uint8_t> >(maxval, params.allowedLossyError), params);
+            return params.components == 4 ?
+                create_codec<Strategy>(DefaultTraits<uint8_t, Quad<uint8_t> >(maxval, params.allowedLossyError), params) :
+                create_codec<Strategy>(DefaultTraits<uint8_t, Triplet<uint8_t> >(maxval, params.allowedLossyError), params);
 
         return create_codec<Strategy>(DefaultTraits<uint8_t, uint8_t>((1u << params.bitsPerSample) - 1, params.allowedLossyError), params);
     }
     if (params.bitsPerSample <= 16)
     {
         if (params.interleaveMode == InterleaveMode::Sample)
-            return create_codec<Strategy>(DefaultTraits<uint16_t,Triplet<uint16_t> >(maxval, params.allowedLossyError), params);
+            return params.components == 4 ?
+                create_codec<Strategy>(DefaultTraits<uint16_t, Quad<uint16_t> >(maxval, params.allowedLossyError), params) :
+                create_codec<Strategy>(DefaultTraits<uint16_t, Triplet<uint16_t> >(maxval, params.allowedLossyError), params);
 
         return create_codec<Strategy>(DefaultTraits<uint16_t, uint16_t>(maxval, params.allowedLossyError), params);
     }
@@ -164,7 +280,24 @@ unique_ptr<Strategy> JlsCodecFactory<Strategy>::CreateOptimizedCodec(const JlsPa
 }
 
 
+template<typename Strategy>
+Strategy& JlsCodecCache<Strategy>::GetCodec(const JlsParameters& params, const JpegLSPresetCodingParameters& presets)
+{
+    if (!codec_ || !HaveSameCodingParameters(params_, params) || !IsEqual(presets_, presets))
+    {
+        codec_.reset();
+        codec_ = JlsCodecFactory<Strategy>().CreateCodec(params, presets);
+        params_ = params;
+        presets_ = presets;
+    }
+
+    return *codec_;
+}
+
+
 template class JlsCodecFactory<DecoderStrategy>;
 template class JlsCodecFactory<EncoderStrategy>;
+template class JlsCodecCache<DecoderStrategy>;
+template class JlsCodecCache<EncoderStrategy>;
 
 } // namespace charls
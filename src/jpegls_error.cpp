@@ -89,6 +89,9 @@ const char* CHARLS_API_CALLING_CONVENTION charls_get_error_message(int32_t error
     case jpegls_errc::jpegls_preset_extended_parameter_type_not_supported:
         return "Unsupported JPEG-LS stream, JPEG-LS preset parameters segment contains an JPEG-LS Extended (ISO/IEC 14495-2) type";
 
+    case jpegls_errc::restart_marker_not_found:
+        return "Invalid JPEG-LS stream, the expected restart marker (RSTm) was not found at the end of a restart interval or was found outside a scan";
+
     case jpegls_errc::invalid_parameter_bits_per_sample:
         return "Invalid JPEG-LS stream, The bit per sample (sample precision) parameter is not in the range [2, 16]";
 
@@ -52,4 +52,10 @@ inline bool IsDefault(const JpegLSPresetCodingParameters& custom) noexcept
     return true;
 }
 
+inline bool IsEqual(const JpegLSPresetCodingParameters& a, const JpegLSPresetCodingParameters& b) noexcept
+{
+    return a.MaximumSampleValue == b.MaximumSampleValue && a.Threshold1 == b.Threshold1 && a.Threshold2 == b.Threshold2 &&
+        a.Threshold3 == b.Threshold3 && a.ResetValue == b.ResetValue;
+}
+
 } // namespace charls
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <cstring>
+#include <cstdint>
 #include <array>
 #include <cassert>
 
@@ -15,8 +16,8 @@ struct Code final
     Code() = default;
 
     Code(int32_t value, int32_t length) noexcept :
-        value_{value},
-        length_{length}
+        value_{static_cast<int16_t>(value)},
+        length_{static_cast<int16_t>(length)}
     {
     }
 
@@ -30,30 +31,33 @@ struct Code final
         return length_;
     }
 
-    int32_t value_{};
-    int32_t length_{};
+    // Note: 16 bit members keep a table with 12 bit indexes at 16 KiB (256 KiB for the 16 tables). Such a table resolves
+    // longer codes than an 8 bit table: fewer codes escape to the slow decoding path.
+    int16_t value_{};
+    int16_t length_{};
 };
 
 
+// A table resolves the unary prefix and the remainder of all codes with a total length of up to bit_count bits in a single lookup.
 class CTable final
 {
 public:
-    static constexpr size_t byte_bit_count = 8;
+    static constexpr size_t bit_count = 12;
 
     CTable() noexcept
     {
         std::memset(types_.data(), 0, sizeof(types_)); // TODO: analyze if needed
     }
 
-    void AddEntry(uint8_t value, Code c) noexcept
+    void AddEntry(int32_t value, Code c) noexcept
     {
         const int32_t length = c.GetLength();
-        ASSERT(static_cast<size_t>(length) <= byte_bit_count);
+        ASSERT(static_cast<size_t>(length) <= bit_count);
 
-        for (int32_t i = 0; i < 1 << (byte_bit_count - length); ++i)
+        for (int32_t i = 0; i < 1 << (bit_count - length); ++i)
         {
-            ASSERT(types_[(static_cast<size_t>(value) << (byte_bit_count - length)) + i].GetLength() == 0);
-            types_[(static_cast<size_t>(value) << (byte_bit_count - length)) + i] = c;
+            ASSERT(types_[(static_cast<size_t>(value) << (bit_count - length)) + i].GetLength() == 0);
+            types_[(static_cast<size_t>(value) << (bit_count - length)) + i] = c;
         }
     }
 
@@ -63,7 +67,7 @@ public:
     }
 
 private:
-    std::array<Code, 1 << byte_bit_count> types_;
+    std::array<Code, 1 << bit_count> types_;
 };
 
 } // namespace charls
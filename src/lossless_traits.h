@@ -8,7 +8,7 @@
 namespace charls
 {
 
-// Optimized trait classes for lossless compression of 8 bit color and 8/16 bit monochrome images.
+// Optimized trait classes for lossless compression of monochrome, color (triplets) and 4 component (quads) images of 2 - 16 bits.
 // This class assumes MaximumSampleValue correspond to a whole number of bits, and no custom ResetValue is set when encoding.
 // The point of this is to have the most optimized code for the most common and most demanding scenario.
 template<typename sample, int32_t bitsPerPixel>
@@ -126,10 +126,22 @@ struct LosslessTraits<Triplet<T>, bpp> final : LosslessTraitsImpl<T, bpp>
     {
         return lhs == rhs;
     }
+};
+
+
+template<typename T, int32_t bpp>
+struct LosslessTraits<Quad<T>, bpp> final : LosslessTraitsImpl<T, bpp>
+{
+    using PIXEL = Quad<T>;
+
+    FORCE_INLINE constexpr static bool IsNear(int32_t lhs, int32_t rhs) noexcept
+    {
+        return lhs == rhs;
+    }
 
-    FORCE_INLINE static T ComputeReconstructedSample(int32_t Px, int32_t errorValue) noexcept
+    FORCE_INLINE static bool IsNear(PIXEL lhs, PIXEL rhs) noexcept
     {
-        return static_cast<T>(Px + errorValue);
+        return lhs == rhs;
     }
 };
 
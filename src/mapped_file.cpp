@@ -0,0 +1,191 @@
+// Copyright (c) Team CharLS. All rights reserved. See the accompanying "LICENSE.md" for licensed use.
+
+#include "mapped_file.h"
+
+#include <charls/jpegls_error.h>
+
+#ifdef _WIN32
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <limits>
+
+namespace charls
+{
+
+#ifdef _WIN32
+
+namespace
+{
+
+// The mapping keeps a reference to the file: the handles can be closed as soon as the view has been mapped.
+uint8_t* MapView(HANDLE file, size_t size, bool writable)
+{
+    const uint64_t size64 = size;
+    HANDLE mapping = CreateFileMappingW(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                        static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+    if (!mapping)
+        return nullptr;
+
+    void* view = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    return static_cast<uint8_t*>(view);
+}
+
+} // namespace
+
+
+MappedFile MappedFile::OpenRead(const char* path)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw jpegls_error{jpegls_errc::invalid_argument_source};
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) > std::numeric_limits<size_t>::max())
+    {
+        CloseHandle(file);
+        throw jpegls_error{jpegls_errc::invalid_argument_source};
+    }
+
+    MappedFile mappedFile;
+    mappedFile.size_ = static_cast<size_t>(fileSize.QuadPart);
+    mappedFile.data_ = mappedFile.size_ == 0 ? nullptr : MapView(file, mappedFile.size_, false);
+    CloseHandle(file);
+
+    if (mappedFile.size_ != 0 && !mappedFile.data_)
+        throw jpegls_error{jpegls_errc::not_enough_memory};
+
+    return mappedFile;
+}
+
+
+MappedFile MappedFile::Create(const char* path, size_t size)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw jpegls_error{jpegls_errc::invalid_argument_destination};
+
+    // Creating the mapping extends the file to its size.
+    MappedFile mappedFile;
+    mappedFile.size_ = size;
+    mappedFile.data_ = size == 0 ? nullptr : MapView(file, size, true);
+    CloseHandle(file);
+
+    if (size != 0 && !mappedFile.data_)
+        throw jpegls_error{jpegls_errc::not_enough_memory};
+
+    return mappedFile;
+}
+
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+    }
+}
+
+#else
+
+namespace
+{
+
+// The mapping keeps a reference to the file: the descriptor can be closed as soon as the file has been mapped.
+uint8_t* MapFile(int fileDescriptor, size_t size, bool writable) noexcept
+{
+    void* data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, writable ? MAP_SHARED : MAP_PRIVATE, fileDescriptor, 0);
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    // The hint is advisory: the mapping works without it.
+    madvise(data, size, MADV_SEQUENTIAL);
+    return static_cast<uint8_t*>(data);
+}
+
+} // namespace
+
+
+MappedFile MappedFile::OpenRead(const char* path)
+{
+    const int fileDescriptor = open(path, O_RDONLY);
+    if (fileDescriptor == -1)
+        throw jpegls_error{jpegls_errc::invalid_argument_source};
+
+    struct stat status{};
+    if (fstat(fileDescriptor, &status) == -1 || !S_ISREG(status.st_mode) ||
+        static_cast<uint64_t>(status.st_size) > std::numeric_limits<size_t>::max())
+    {
+        close(fileDescriptor);
+        throw jpegls_error{jpegls_errc::invalid_argument_source};
+    }
+
+    MappedFile mappedFile;
+    mappedFile.size_ = static_cast<size_t>(status.st_size);
+    mappedFile.data_ = mappedFile.size_ == 0 ? nullptr : MapFile(fileDescriptor, mappedFile.size_, false);
+    close(fileDescriptor);
+
+    if (mappedFile.size_ != 0 && !mappedFile.data_)
+        throw jpegls_error{jpegls_errc::not_enough_memory};
+
+    return mappedFile;
+}
+
+
+MappedFile MappedFile::Create(const char* path, size_t size)
+{
+    const int fileDescriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor == -1)
+        throw jpegls_error{jpegls_errc::invalid_argument_destination};
+
+    if (ftruncate(fileDescriptor, static_cast<off_t>(size)) == -1)
+    {
+        close(fileDescriptor);
+        throw jpegls_error{jpegls_errc::invalid_argument_destination};
+    }
+
+    MappedFile mappedFile;
+    mappedFile.size_ = size;
+    mappedFile.data_ = size == 0 ? nullptr : MapFile(fileDescriptor, size, true);
+    close(fileDescriptor);
+
+    if (size != 0 && !mappedFile.data_)
+        throw jpegls_error{jpegls_errc::not_enough_memory};
+
+    return mappedFile;
+}
+
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        munmap(data_, size_);
+    }
+}
+
+#endif
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    data_{other.data_},
+    size_{other.size_}
+{
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+} // namespace charls
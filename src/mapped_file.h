@@ -0,0 +1,45 @@
+// Copyright (c) Team CharLS. All rights reserved. See the accompanying "LICENSE.md" for licensed use.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace charls
+{
+
+// Purpose: maps a file in memory, the codec reads or writes the pages of the file directly instead of a copy in a buffer.
+// The mapping is made with a sequential access hint: the operating system reads ahead and drops the pages behind the codec.
+class MappedFile final
+{
+public:
+    // Maps an existing file for reading, throws invalid_argument_source when the file cannot be opened.
+    static MappedFile OpenRead(const char* path);
+
+    // Creates (or truncates) a file of size bytes and maps it for writing, throws invalid_argument_destination when the file cannot be created.
+    static MappedFile Create(const char* path, size_t size);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+    ~MappedFile();
+
+    uint8_t* GetData() const noexcept
+    {
+        return data_;
+    }
+
+    size_t GetSize() const noexcept
+    {
+        return size_;
+    }
+
+private:
+    MappedFile() = default;
+
+    uint8_t* data_{};
+    size_t size_{};
+};
+
+} // namespace charls
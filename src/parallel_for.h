@@ -0,0 +1,101 @@
+// Copyright (c) Team CharLS. All rights reserved. See the accompanying "LICENSE.md" for licensed use.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace charls
+{
+
+// Returns the number of threads ParallelForWorker uses (the calling thread included) at most, for state per thread.
+inline size_t ParallelWorkerCount(size_t count, int32_t threadCount) noexcept
+{
+    return std::min(count, static_cast<size_t>(std::max(threadCount, 1)));
+}
+
+
+// Calls function(index, workerIndex) for every index in [0, count) using at most threadCount threads, the calling thread included.
+// workerIndex is unique for every thread and smaller than ParallelWorkerCount(count, threadCount).
+// Indices are handed out one at a time, which keeps all threads busy when work items have a different cost.
+// When a call throws, no new work items are started and the first exception is rethrown on the calling thread.
+template<typename Function>
+void ParallelForWorker(size_t count, int32_t threadCount, Function function)
+{
+    const size_t workerCount = ParallelWorkerCount(count, threadCount);
+    if (workerCount <= 1)
+    {
+        for (size_t index = 0; index < count; ++index)
+        {
+            function(index, size_t{});
+        }
+        return;
+    }
+
+    std::atomic<size_t> nextIndex{};
+    std::atomic<bool> failed{};
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+
+    const auto worker = [&](size_t workerIndex)
+    {
+        for (size_t index = nextIndex++; index < count && !failed; index = nextIndex++)
+        {
+            try
+            {
+                function(index, workerIndex);
+            }
+            catch (...)
+            {
+                const std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!exception)
+                {
+                    exception = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+    for (size_t i = 1; i < workerCount; ++i)
+    {
+        try
+        {
+            threads.emplace_back(worker, i);
+        }
+        catch (const std::system_error&)
+        {
+            // Not able to start more threads: continue with the threads that are already running.
+            break;
+        }
+    }
+
+    worker(size_t{});
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+
+// Calls function(index) for every index in [0, count), like ParallelForWorker.
+template<typename Function>
+void ParallelFor(size_t count, int32_t threadCount, Function function)
+{
+    ParallelForWorker(count, threadCount, [&function](size_t index, size_t) { function(index); });
+}
+
+} // namespace charls
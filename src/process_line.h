@@ -5,11 +5,13 @@
 #include <charls/jpegls_error.h>
 
 #include "util.h"
+#include "color_transform.h"
 
 #include <vector>
 #include <sstream>
 #include <cstring>
 #include <algorithm>
+#include <type_traits>
 
 
 //
@@ -37,6 +39,18 @@ public:
     virtual void NewLineDecoded(const void* pSrc, int pixelCount, int sourceStride) = 0;
     virtual void NewLineRequested(void* pDest, int pixelCount, int destStride) = 0;
 
+    // Starts again at the first line of other uncompressed data. Returns false when a new object is needed for this data.
+    virtual bool Reset(ByteStreamInfo /*rawStreamInfo*/) noexcept
+    {
+        return false;
+    }
+
+    // Returns the buffer decoded lines are copied to when a decoder may write them there directly, nullptr otherwise.
+    virtual uint8_t* DirectLineBuffer(size_t& /*bytesPerLine*/) noexcept
+    {
+        return nullptr;
+    }
+
 protected:
     ProcessLine() = default;
 };
@@ -64,6 +78,18 @@ public:
         rawData_ += bytesPerLine_;
     }
 
+    bool Reset(ByteStreamInfo rawStreamInfo) noexcept override
+    {
+        rawData_ = rawStreamInfo.rawData;
+        return rawData_ != nullptr;
+    }
+
+    uint8_t* DirectLineBuffer(size_t& bytesPerLine) noexcept override
+    {
+        bytesPerLine = bytesPerLine_;
+        return rawData_;
+    }
+
 private:
     uint8_t* rawData_;
     size_t bytesPerPixel_;
@@ -107,7 +133,7 @@ public:
         {
             const auto bytesRead = rawData_->sgetn(static_cast<char*>(destination), bytesToRead);
             if (bytesRead == 0)
-                throw jpegls_error{jpegls_errc::destination_buffer_too_small};
+                throw jpegls_error{jpegls_errc::source_buffer_too_small};
 
             bytesToRead = bytesToRead - bytesRead;
         }
@@ -131,6 +157,12 @@ public:
             throw jpegls_error{jpegls_errc::destination_buffer_too_small};
     }
 
+    bool Reset(ByteStreamInfo rawStreamInfo) noexcept override
+    {
+        rawData_ = rawStreamInfo.rawStream;
+        return rawData_ != nullptr;
+    }
+
 private:
     std::basic_streambuf<char>* rawData_;
     size_t bytesPerPixel_;
@@ -171,6 +203,24 @@ void TransformQuadToLine(const Quad<T>* byteInput, int32_t pixelStrideIn, T* pty
 }
 
 
+// Transforms sample interleaved quads, the color transformations leave the fourth component unchanged.
+template<typename TRANSFORM, typename T>
+void TransformQuads(T* destination, const T* source, int32_t pixelCount, TRANSFORM& transform) noexcept
+{
+    for (auto x = 0; x < pixelCount; ++x)
+    {
+        const Quad<T> color(transform(source[0], source[1], source[2]), source[3]);
+        destination[0] = color.v1;
+        destination[1] = color.v2;
+        destination[2] = color.v3;
+        destination[3] = color.v4;
+
+        source += 4;
+        destination += 4;
+    }
+}
+
+
 template<typename T>
 void TransformRgbToBgr(T* pDest, int samplesPerPixel, int pixelCount) noexcept
 {
@@ -182,36 +232,155 @@ void TransformRgbToBgr(T* pDest, int samplesPerPixel, int pixelCount) noexcept
 }
 
 
+// Masks that select the samples of a block of sample interleaved triplets by their position in the pixel.
+template<typename T, int SampleCount>
+struct TripletPositionMasks final
+{
+    constexpr TripletPositionMasks() noexcept :
+        first{},
+        second{},
+        third{}
+    {
+        for (auto i = 0; i < SampleCount; i += 3)
+        {
+            first[i] = static_cast<T>(~0);
+            second[i + 1] = static_cast<T>(~0);
+            third[i + 2] = static_cast<T>(~0);
+        }
+    }
+
+    T first[SampleCount];
+    T second[SampleCount];
+    T third[SampleCount];
+};
+
+
 template<typename TRANSFORM, typename T>
-void TransformLine(Triplet<T>* pDest, const Triplet<T>* pSrc, int pixelCount, TRANSFORM& transform) noexcept
+FORCE_INLINE void TransformTriplet(T* destination, const T* source, TRANSFORM& transform) noexcept
 {
-    for (auto i = 0; i < pixelCount; ++i)
+    const Triplet<T> color = transform(source[0], source[1], source[2]);
+    destination[0] = color.v1;
+    destination[1] = color.v2;
+    destination[2] = color.v3;
+}
+
+
+// Transforms a line of sample interleaved triplets, source and destination may not overlap.
+// When InBlocks is true, all but the first and last pixel are transformed in blocks of 16 pixels.
+// Every transformed sample only depends on the samples of its own pixel, which are at a fixed distance of it.
+// The block loop computes the result for all 3 positions a sample can have in its pixel and selects the right one
+// with a mask. This triples the arithmetic, but it gives compilers a loop without the (de)interleaving shuffles
+// that vectorizes for every instruction set: with SSE2 16 8-bit samples are transformed per instruction.
+template<typename TRANSFORM, typename T, typename InBlocks>
+void TransformLine(T* destination, const T* source, int pixelCount, TRANSFORM& transform, InBlocks) noexcept
+{
+    constexpr int pixelsPerBlock = 16;
+    constexpr int samplesPerBlock = pixelsPerBlock * 3;
+    static constexpr TripletPositionMasks<T, samplesPerBlock> masks;
+
+    // The block loop reads 2 samples before and after a block.
+    const int blockCount = InBlocks::value ? std::max(pixelCount - 2, 0) / pixelsPerBlock : 0;
+
+    auto x = 0;
+    if (blockCount > 0)
     {
-        pDest[i] = transform(pSrc[i].v1, pSrc[i].v2, pSrc[i].v3);
+        TransformTriplet(destination, source, transform);
+        for (x = 1; x < 1 + blockCount * pixelsPerBlock; x += pixelsPerBlock)
+        {
+            const T* blockSource = source + x * 3;
+            T* blockDestination = destination + x * 3;
+
+            for (auto i = 0; i < samplesPerBlock; ++i)
+            {
+                const T first = transform(blockSource[i], blockSource[i + 1], blockSource[i + 2]).v1;
+                const T second = transform(blockSource[i - 1], blockSource[i], blockSource[i + 1]).v2;
+                const T third = transform(blockSource[i - 2], blockSource[i - 1], blockSource[i]).v3;
+                blockDestination[i] = static_cast<T>((first & masks.first[i]) | (second & masks.second[i]) | (third & masks.third[i]));
+            }
+        }
+    }
+
+    for (; x < pixelCount; ++x)
+    {
+        TransformTriplet(destination + x * 3, source + x * 3, transform);
     }
 }
 
 
-template<typename TRANSFORM, typename T>
-void TransformLineToTriplet(const T* ptypeInput, int32_t pixelStrideIn, Triplet<T>* byteBuffer, int32_t pixelStride, TRANSFORM& transform) noexcept
+// When InBlocks is true, the line interleaved transforms work on blocks of 32 pixels: the color transform is done
+// between the component planes and local arrays and the (de)interleaving in a separate loop.
+// Compilers can vectorize both loops, which is not possible when they are combined.
+constexpr int TransformPixelsPerBlock = 32;
+
+
+template<typename TRANSFORM, typename T, typename InBlocks>
+void TransformLineToTriplet(const T* ptypeInput, int32_t pixelStrideIn, Triplet<T>* byteBuffer, int32_t pixelStride, TRANSFORM& transform, InBlocks) noexcept
 {
     const auto cpixel = std::min(pixelStride, pixelStrideIn);
     Triplet<T>* ptypeBuffer = byteBuffer;
 
-    for (auto x = 0; x < cpixel; ++x)
+    const int blocksEnd = InBlocks::value ? cpixel - cpixel % TransformPixelsPerBlock : 0;
+
+    auto x = 0;
+    for (; x < blocksEnd; x += TransformPixelsPerBlock)
+    {
+        T v1[TransformPixelsPerBlock];
+        T v2[TransformPixelsPerBlock];
+        T v3[TransformPixelsPerBlock];
+        for (auto i = 0; i < TransformPixelsPerBlock; ++i)
+        {
+            const Triplet<T> color = transform(ptypeInput[x + i], ptypeInput[x + i + pixelStrideIn], ptypeInput[x + i + 2 * pixelStrideIn]);
+            v1[i] = color.v1;
+            v2[i] = color.v2;
+            v3[i] = color.v3;
+        }
+
+        for (auto i = 0; i < TransformPixelsPerBlock; ++i)
+        {
+            ptypeBuffer[x + i] = Triplet<T>(v1[i], v2[i], v3[i]);
+        }
+    }
+
+    for (; x < cpixel; ++x)
     {
         ptypeBuffer[x] = transform(ptypeInput[x], ptypeInput[x + pixelStrideIn], ptypeInput[x + 2*pixelStrideIn]);
     }
 }
 
 
-template<typename TRANSFORM, typename T>
-void TransformTripletToLine(const Triplet<T>* byteInput, int32_t pixelStrideIn, T* ptypeBuffer, int32_t pixelStride, TRANSFORM& transform) noexcept
+template<typename TRANSFORM, typename T, typename InBlocks>
+void TransformTripletToLine(const Triplet<T>* byteInput, int32_t pixelStrideIn, T* ptypeBuffer, int32_t pixelStride, TRANSFORM& transform, InBlocks) noexcept
 {
     const auto cpixel = std::min(pixelStride, pixelStrideIn);
     const Triplet<T>* ptypeBufferIn = byteInput;
 
-    for (auto x = 0; x < cpixel; ++x)
+    const int blocksEnd = InBlocks::value ? cpixel - cpixel % TransformPixelsPerBlock : 0;
+
+    auto x = 0;
+    for (; x < blocksEnd; x += TransformPixelsPerBlock)
+    {
+        T v1[TransformPixelsPerBlock];
+        T v2[TransformPixelsPerBlock];
+        T v3[TransformPixelsPerBlock];
+        for (auto i = 0; i < TransformPixelsPerBlock; ++i)
+        {
+            const Triplet<T> color = ptypeBufferIn[x + i];
+            v1[i] = color.v1;
+            v2[i] = color.v2;
+            v3[i] = color.v3;
+        }
+
+        for (auto i = 0; i < TransformPixelsPerBlock; ++i)
+        {
+            const Triplet<T> colorTransformed = transform(v1[i], v2[i], v3[i]);
+
+            ptypeBuffer[x + i] = colorTransformed.v1;
+            ptypeBuffer[x + i + pixelStride] = colorTransformed.v2;
+            ptypeBuffer[x + i + 2 * pixelStride] = colorTransformed.v3;
+        }
+    }
+
+    for (; x < cpixel; ++x)
     {
         const Triplet<T> color = ptypeBufferIn[x];
         const Triplet<T> colorTransformed = transform(color.v1, color.v2, color.v3);
@@ -223,6 +392,29 @@ void TransformTripletToLine(const Triplet<T>* byteInput, int32_t pixelStrideIn,
 }
 
 
+// The sample interleaved block loop computes every sample 3 times. This only pays off for transforms with a few
+// operations per sample: not for the shifts of TransformShifted and for HP3 with 16 bit samples, as measured with SSE2.
+template<typename Transform>
+struct TransformSampleInterleavedInBlocks : std::false_type
+{
+};
+
+template<typename T>
+struct TransformSampleInterleavedInBlocks<TransformHp1<T>> : std::true_type
+{
+};
+
+template<typename T>
+struct TransformSampleInterleavedInBlocks<TransformHp2<T>> : std::true_type
+{
+};
+
+template<>
+struct TransformSampleInterleavedInBlocks<TransformHp3<uint8_t>> : std::true_type
+{
+};
+
+
 template<typename TRANSFORM>
 class ProcessTransformed final : public ProcessLine
 {
@@ -237,6 +429,12 @@ public:
     {
     }
 
+    bool Reset(ByteStreamInfo rawStreamInfo) noexcept override
+    {
+        rawPixels_ = rawStreamInfo;
+        return true;
+    }
+
     void NewLineRequested(void* dest, int pixelCount, int destStride) override
     {
         if (!rawPixels_.rawStream)
@@ -267,7 +465,7 @@ public:
     {
         if (params_.outputBgr)
         {
-            memcpy(tempLine_.data(), source, sizeof(Triplet<size_type>) * pixelCount);
+            memcpy(tempLine_.data(), source, sizeof(size_type) * params_.components * pixelCount);
             TransformRgbToBgr(tempLine_.data(), params_.components, pixelCount);
             source = tempLine_.data();
         }
@@ -276,16 +474,23 @@ public:
         {
             if (params_.interleaveMode == InterleaveMode::Sample)
             {
-                TransformLine(static_cast<Triplet<size_type>*>(dest), static_cast<const Triplet<size_type>*>(source), pixelCount, transform_);
+                TransformLine(static_cast<size_type*>(dest), static_cast<const size_type*>(source), pixelCount, transform_, SampleInterleavedInBlocks{});
             }
             else
             {
-                TransformTripletToLine(static_cast<const Triplet<size_type>*>(source), pixelCount, static_cast<size_type*>(dest), destStride, transform_);
+                TransformTripletToLine(static_cast<const Triplet<size_type>*>(source), pixelCount, static_cast<size_type*>(dest), destStride, transform_, LineInterleavedInBlocks{});
             }
         }
-        else if (params_.components == 4 && params_.interleaveMode == InterleaveMode::Line)
+        else if (params_.components == 4)
         {
-            TransformQuadToLine(static_cast<const Quad<size_type>*>(source), pixelCount, static_cast<size_type*>(dest), destStride, transform_);
+            if (params_.interleaveMode == InterleaveMode::Sample)
+            {
+                TransformQuads(static_cast<size_type*>(dest), static_cast<const size_type*>(source), pixelCount, transform_);
+            }
+            else
+            {
+                TransformQuadToLine(static_cast<const Quad<size_type>*>(source), pixelCount, static_cast<size_type*>(dest), destStride, transform_);
+            }
         }
     }
 
@@ -295,16 +500,23 @@ public:
         {
             if (params_.interleaveMode == InterleaveMode::Sample)
             {
-                TransformLine(static_cast<Triplet<size_type>*>(rawData), static_cast<const Triplet<size_type>*>(pSrc), pixelCount, inverseTransform_);
+                TransformLine(static_cast<size_type*>(rawData), static_cast<const size_type*>(pSrc), pixelCount, inverseTransform_, SampleInterleavedInBlocks{});
             }
             else
             {
-                TransformLineToTriplet(static_cast<const size_type*>(pSrc), byteStride, static_cast<Triplet<size_type>*>(rawData), pixelCount, inverseTransform_);
+                TransformLineToTriplet(static_cast<const size_type*>(pSrc), byteStride, static_cast<Triplet<size_type>*>(rawData), pixelCount, inverseTransform_, LineInterleavedInBlocks{});
             }
         }
-        else if (params_.components == 4 && params_.interleaveMode == InterleaveMode::Line)
+        else if (params_.components == 4)
         {
-            TransformLineToQuad(static_cast<const size_type*>(pSrc), byteStride, static_cast<Quad<size_type>*>(rawData), pixelCount, inverseTransform_);
+            if (params_.interleaveMode == InterleaveMode::Sample)
+            {
+                TransformQuads(static_cast<size_type*>(rawData), static_cast<const size_type*>(pSrc), pixelCount, inverseTransform_);
+            }
+            else
+            {
+                TransformLineToQuad(static_cast<const size_type*>(pSrc), byteStride, static_cast<Quad<size_type>*>(rawData), pixelCount, inverseTransform_);
+            }
         }
 
         if (params_.outputBgr)
@@ -333,6 +545,10 @@ public:
 
 private:
     using size_type = typename TRANSFORM::size_type;
+    using SampleInterleavedInBlocks = TransformSampleInterleavedInBlocks<TRANSFORM>;
+
+    // Only TransformNone, which just (de)interleaves, is faster without the extra copy of the blocks.
+    using LineInterleavedInBlocks = std::integral_constant<bool, !std::is_same<TRANSFORM, TransformNone<size_type>>::value>;
 
     const JlsParameters& params_;
     std::vector<size_type> tempLine_;
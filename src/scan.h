@@ -8,8 +8,11 @@
 #include "color_transform.h"
 #include "process_line.h"
 
+#include <algorithm>
 #include <sstream>
 #include <array>
+#include <memory>
+#include <type_traits>
 
 // This file contains the code for handling a "scan". Usually an image is encoded as a single scan.
 
@@ -22,6 +25,10 @@ extern std::vector<signed char> rgquant10Ll;
 extern std::vector<signed char> rgquant12Ll;
 extern std::vector<signed char> rgquant16Ll;
 
+// Returns the quantization lookup table for the sample differences -2^bitsPerSample to 2^bitsPerSample - 1.
+// Tables are immutable and shared by all codecs (also on other threads) that use the same parameters.
+std::shared_ptr<const std::vector<signed char>> GetQuantizationLut(int32_t bitsPerSample, int32_t near, int32_t t1, int32_t t2, int32_t t3);
+
 constexpr int32_t ApplySign(int32_t i, int32_t sign) noexcept
 {
     return (sign ^ i) - sign;
@@ -149,6 +156,18 @@ public:
         return *(pquant_ + Di);
     }
 
+    // Branch free equivalent of QuantizeGradient for lossless coding with ordered thresholds (0 < T1 <= T2 <= T3).
+    FORCE_INLINE int32_t QuantizeGradientLossless(int32_t Di) const noexcept
+    {
+        return (Di > 0) + (Di >= T1) + (Di >= T2) + (Di >= T3) - (Di < 0) - (Di <= -T1) - (Di <= -T2) - (Di <= -T3);
+    }
+
+    bool CanComputeContextIdsAhead() const noexcept
+    {
+        return std::is_same<Strategy, EncoderStrategy>::value && traits.NEAR == 0 && 0 < T1 && T1 <= T2 && T2 <= T3;
+    }
+
+    void ComputeContextIds() noexcept;
     void InitQuantizationLUT();
 
     int32_t DecodeValue(int32_t k, int32_t limit, int32_t qbpp);
@@ -166,6 +185,7 @@ public:
 
     int32_t DecodeRIError(CContextRunMode& ctx);
     Triplet<SAMPLE> DecodeRIPixel(Triplet<SAMPLE> Ra, Triplet<SAMPLE> Rb);
+    Quad<SAMPLE> DecodeRIPixel(Quad<SAMPLE> Ra, Quad<SAMPLE> Rb);
     SAMPLE DecodeRIPixel(int32_t Ra, int32_t Rb);
     int32_t DecodeRunPixels(PIXEL Ra, PIXEL* startPos, int32_t cpixelMac);
     int32_t DoRunMode(int32_t startIndex, DecoderStrategy*);
@@ -173,6 +193,7 @@ public:
     void EncodeRIError(CContextRunMode& ctx, int32_t errorValue);
     SAMPLE EncodeRIPixel(int32_t x, int32_t Ra, int32_t Rb);
     Triplet<SAMPLE> EncodeRIPixel(Triplet<SAMPLE> x, Triplet<SAMPLE> Ra, Triplet<SAMPLE> Rb);
+    Quad<SAMPLE> EncodeRIPixel(Quad<SAMPLE> x, Quad<SAMPLE> Ra, Quad<SAMPLE> Rb);
     void EncodeRunPixels(int32_t runLength, bool endOfLine);
     int32_t DoRunMode(int32_t index, EncoderStrategy*);
 
@@ -181,9 +202,14 @@ public:
 
     void DoLine(SAMPLE* dummy);
     void DoLine(Triplet<SAMPLE>* dummy);
+    void DoLine(Quad<SAMPLE>* dummy);
     void DoScan();
+    void StartScanLines();
+    void DoScanLine();
+    uint8_t* DirectDestination(size_t& stride) noexcept;
 
     void InitParams(int32_t t1, int32_t t2, int32_t t3, int32_t nReset);
+    void ResetParameters() noexcept;
 
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -193,6 +219,8 @@ public:
     // Note: depending on the base class EncodeScan OR DecodeScan will be virtual and abstract, cannot use override in all cases.
     size_t EncodeScan(std::unique_ptr<ProcessLine> processLine, ByteStreamInfo& compressedData);
     void DecodeScan(std::unique_ptr<ProcessLine> processLine, const JlsRect& rect, ByteStreamInfo& compressedData);
+    void StartDecodeScan(std::unique_ptr<ProcessLine> processLine, const JlsRect& rect, ByteStreamInfo& compressedData);
+    void DecodeLine();
 
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -206,6 +234,7 @@ protected:
     int32_t T1{};
     int32_t T2{};
     int32_t T3{};
+    int32_t resetValue_{};
 
     // compression context
     std::array<JlsContext, 365> contexts_;
@@ -213,10 +242,24 @@ protected:
     int32_t RUNindex_{};
     PIXEL* previousLine_{};
     PIXEL* currentLine_{};
+    PIXEL leftOfPreviousLine_{}; // Rc of the first sample of the current line
 
     // quantization lookup table
-    signed char* pquant_{};
-    std::vector<signed char> rgquant_;
+    const signed char* pquant_{};
+    std::shared_ptr<const std::vector<signed char>> quantizationLut_;
+
+    // context IDs of the current line, only used by the lossless encoder
+    std::vector<int32_t> contextIds_;
+
+    // line buffers and run indexes (one per component in ILV_LINE mode) of DoScan, kept when the codec is used for more than one scan
+    std::vector<PIXEL> lineBuffer_;
+    std::vector<int32_t> componentRunIndex_;
+
+    // next line of the scan, the line after the last decoded line and the destination rows when single component lines are decoded without line buffers
+    int32_t line_{};
+    int32_t endLine_{};
+    uint8_t* directDestination_{};
+    size_t directStride_{};
 };
 
 
@@ -230,10 +273,10 @@ typename Traits::SAMPLE JlsCodec<Traits,Strategy>::DoRegular(int32_t Qs, int32_t
     const int32_t Px = traits.CorrectPrediction(pred + ApplySign(ctx.C, sign));
 
     int32_t ErrVal;
-    const Code& code = decodingTables[k].Get(Strategy::PeekByte());
+    const Code& code = decodingTables[k].Get(Strategy::PeekBits(CTable::bit_count));
     if (code.GetLength() != 0)
     {
-        Strategy::Skip(code.GetLength());
+        Strategy::SkipPeekedBits(code.GetLength());
         ErrVal = code.GetValue();
         ASSERT(std::abs(ErrVal) < 65535);
     }
@@ -286,11 +329,11 @@ inline CTable InitTable(int32_t k) noexcept
         // Q is not used when k != 0
         const int32_t merrval = GetMappedErrVal(nerr);
         const std::pair<int32_t, int32_t> pairCode = CreateEncodedValue(k, merrval);
-        if (static_cast<size_t>(pairCode.first) > CTable::byte_bit_count)
+        if (static_cast<size_t>(pairCode.first) > CTable::bit_count)
             break;
 
         const Code code(nerr, static_cast<short>(pairCode.first));
-        table.AddEntry(static_cast<uint8_t>(pairCode.second), code);
+        table.AddEntry(pairCode.second, code);
     }
 
     for (short nerr = -1; ; nerr--)
@@ -298,11 +341,11 @@ inline CTable InitTable(int32_t k) noexcept
         // Q is not used when k != 0
         const int32_t merrval = GetMappedErrVal(nerr);
         const std::pair<int32_t, int32_t> pairCode = CreateEncodedValue(k, merrval);
-        if (static_cast<size_t>(pairCode.first) > CTable::byte_bit_count)
+        if (static_cast<size_t>(pairCode.first) > CTable::bit_count)
             break;
 
         const Code code = Code(nerr, static_cast<short>(pairCode.first));
-        table.AddEntry(static_cast<uint8_t>(pairCode.second), code);
+        table.AddEntry(pairCode.second, code);
     }
 
     return table;
@@ -394,15 +437,8 @@ void JlsCodec<Traits, Strategy>::InitQuantizationLUT()
         }
     }
 
-    const int32_t RANGE = 1 << traits.bpp;
-
-    rgquant_.resize(static_cast<size_t>(RANGE) * 2);
-
-    pquant_ = &rgquant_[RANGE];
-    for (int32_t i = -RANGE; i < RANGE; ++i)
-    {
-        pquant_[i] = QuantizeGradientOrg(i);
-    }
+    quantizationLut_ = GetQuantizationLut(traits.bpp, traits.NEAR, T1, T2, T3);
+    pquant_ = &(*quantizationLut_)[quantizationLut_->size() / 2];
 }
 
 MSVC_WARNING_UNSUPPRESS()
@@ -480,6 +516,43 @@ Triplet<typename Traits::SAMPLE> JlsCodec<Traits,Strategy>::EncodeRIPixel(Triple
 }
 
 
+template<typename Traits, typename Strategy>
+Quad<typename Traits::SAMPLE> JlsCodec<Traits,Strategy>::DecodeRIPixel(Quad<SAMPLE> Ra, Quad<SAMPLE> Rb)
+{
+    const int32_t errorValue1 = DecodeRIError(contextRunmode_[0]);
+    const int32_t errorValue2 = DecodeRIError(contextRunmode_[0]);
+    const int32_t errorValue3 = DecodeRIError(contextRunmode_[0]);
+    const int32_t errorValue4 = DecodeRIError(contextRunmode_[0]);
+
+    return Quad<SAMPLE>(traits.ComputeReconstructedSample(Rb.v1, errorValue1 * Sign(Rb.v1  - Ra.v1)),
+                        traits.ComputeReconstructedSample(Rb.v2, errorValue2 * Sign(Rb.v2  - Ra.v2)),
+                        traits.ComputeReconstructedSample(Rb.v3, errorValue3 * Sign(Rb.v3  - Ra.v3)),
+                        traits.ComputeReconstructedSample(Rb.v4, errorValue4 * Sign(Rb.v4  - Ra.v4)));
+}
+
+
+template<typename Traits, typename Strategy>
+Quad<typename Traits::SAMPLE> JlsCodec<Traits,Strategy>::EncodeRIPixel(Quad<SAMPLE> x, Quad<SAMPLE> Ra, Quad<SAMPLE> Rb)
+{
+    const int32_t errorValue1 = traits.ComputeErrVal(Sign(Rb.v1 - Ra.v1) * (x.v1 - Rb.v1));
+    EncodeRIError(contextRunmode_[0], errorValue1);
+
+    const int32_t errorValue2 = traits.ComputeErrVal(Sign(Rb.v2 - Ra.v2) * (x.v2 - Rb.v2));
+    EncodeRIError(contextRunmode_[0], errorValue2);
+
+    const int32_t errorValue3 = traits.ComputeErrVal(Sign(Rb.v3 - Ra.v3) * (x.v3 - Rb.v3));
+    EncodeRIError(contextRunmode_[0], errorValue3);
+
+    const int32_t errorValue4 = traits.ComputeErrVal(Sign(Rb.v4 - Ra.v4) * (x.v4 - Rb.v4));
+    EncodeRIError(contextRunmode_[0], errorValue4);
+
+    return Quad<SAMPLE>(traits.ComputeReconstructedSample(Rb.v1, errorValue1 * Sign(Rb.v1  - Ra.v1)),
+                        traits.ComputeReconstructedSample(Rb.v2, errorValue2 * Sign(Rb.v2  - Ra.v2)),
+                        traits.ComputeReconstructedSample(Rb.v3, errorValue3 * Sign(Rb.v3  - Ra.v3)),
+                        traits.ComputeReconstructedSample(Rb.v4, errorValue4 * Sign(Rb.v4  - Ra.v4)));
+}
+
+
 template<typename Traits, typename Strategy>
 typename Traits::SAMPLE JlsCodec<Traits,Strategy>::DecodeRIPixel(int32_t Ra, int32_t Rb)
 {
@@ -564,11 +637,7 @@ int32_t JlsCodec<Traits, Strategy>::DecodeRunPixels(PIXEL Ra, PIXEL* startPos, i
     if (index > cpixelMac)
         throw jpegls_error{jpegls_errc::invalid_encoded_data};
 
-    for (int32_t i = 0; i < index; ++i)
-    {
-        startPos[i] = Ra;
-    }
-
+    std::fill_n(startPos, index, Ra);
     return index;
 }
 
@@ -581,17 +650,32 @@ int32_t JlsCodec<Traits, Strategy>::DoRunMode(int32_t index, EncoderStrategy*)
 
     const PIXEL Ra = ptypeCurX[-1];
 
+    // The samples of a block are compared without an early exit: the compiler can vectorize the comparisons of a block.
+    // The remainder of the run is found sample by sample.
+    constexpr int32_t RunBlockSize = 16;
     int32_t runLength = 0;
-
-    while (traits.IsNear(ptypeCurX[runLength],Ra))
+    while (runLength + RunBlockSize <= ctypeRem)
     {
-        ptypeCurX[runLength] = Ra;
-        runLength++;
+        int32_t nearCount = 0;
+        for (int32_t i = 0; i < RunBlockSize; ++i)
+        {
+            nearCount += traits.IsNear(ptypeCurX[runLength + i], Ra);
+        }
 
-        if (runLength == ctypeRem)
+        if (nearCount != RunBlockSize)
             break;
+
+        runLength += RunBlockSize;
     }
 
+    while (runLength != ctypeRem && traits.IsNear(ptypeCurX[runLength], Ra))
+    {
+        ++runLength;
+    }
+
+    // In near-lossless mode the run samples are reconstructed as Ra.
+    std::fill_n(ptypeCurX, runLength, Ra);
+
     EncodeRunPixels(runLength, runLength == ctypeRem);
 
     if (runLength == ctypeRem)
@@ -606,7 +690,8 @@ int32_t JlsCodec<Traits, Strategy>::DoRunMode(int32_t index, EncoderStrategy*)
 template<typename Traits, typename Strategy>
 int32_t JlsCodec<Traits, Strategy>::DoRunMode(int32_t startIndex, DecoderStrategy*)
 {
-    const PIXEL Ra = currentLine_[startIndex-1];
+    // The edge sample left of a line is equal to the first sample of the previous line.
+    const PIXEL Ra = startIndex == 0 ? previousLine_[0] : currentLine_[startIndex-1];
 
     const int32_t runLength = DecodeRunPixels(Ra, currentLine_ + startIndex, width_ - startIndex);
     const int32_t endIndex = startIndex + runLength;
@@ -622,33 +707,68 @@ int32_t JlsCodec<Traits, Strategy>::DoRunMode(int32_t startIndex, DecoderStrateg
 }
 
 
+/// <summary>
+/// Computes the context IDs of all samples of the current line. When encoding lossless, the current line already contains
+/// the reconstructed values. This loop has no dependencies between samples and can be vectorized by the compiler.
+/// </summary>
+template<typename Traits, typename Strategy>
+void JlsCodec<Traits, Strategy>::ComputeContextIds() noexcept
+{
+    const PIXEL* previousLine = previousLine_;
+    const PIXEL* currentLine = currentLine_;
+    int32_t* contextIds = contextIds_.data();
+    const int32_t width = width_;
+
+    for (int32_t index = 0; index < width; ++index)
+    {
+        const int32_t Ra = currentLine[index - 1];
+        const int32_t Rb = previousLine[index];
+        const int32_t Rc = previousLine[index - 1];
+        const int32_t Rd = previousLine[index + 1];
+
+        contextIds[index] = ComputeContextID(QuantizeGradientLossless(Rd - Rb), QuantizeGradientLossless(Rb - Rc), QuantizeGradientLossless(Rc - Ra));
+    }
+}
+
+
 /// <summary>Encodes/Decodes a scan line of samples</summary>
 template<typename Traits, typename Strategy>
 void JlsCodec<Traits, Strategy>::DoLine(SAMPLE*)
 {
+    const bool contextIdsAhead = CanComputeContextIdsAhead();
+    if (contextIdsAhead)
+    {
+        contextIds_.resize(width_);
+        ComputeContextIds();
+    }
+
+    // The edge samples are kept in registers: lines decoded directly into the destination have no padding around them.
     int32_t index = 0;
-    int32_t Rb = previousLine_[index-1];
-    int32_t Rd = previousLine_[index];
+    int32_t Ra = previousLine_[0];
+    int32_t Rb = leftOfPreviousLine_;
+    int32_t Rd = previousLine_[0];
 
     while (index < width_)
     {
-        const int32_t Ra = currentLine_[index -1];
         const int32_t Rc = Rb;
         Rb = Rd;
-        Rd = previousLine_[index + 1];
+        Rd = index + 1 < width_ ? previousLine_[index + 1] : Rb;
 
-        const int32_t Qs = ComputeContextID(QuantizeGradient(Rd - Rb), QuantizeGradient(Rb - Rc), QuantizeGradient(Rc - Ra));
+        const int32_t Qs = contextIdsAhead ? contextIds_[index] :
+            ComputeContextID(QuantizeGradient(Rd - Rb), QuantizeGradient(Rb - Rc), QuantizeGradient(Rc - Ra));
 
         if (Qs != 0)
         {
-            currentLine_[index] = DoRegular(Qs, currentLine_[index], GetPredictedValue(Ra, Rb, Rc), static_cast<Strategy*>(nullptr));
+            Ra = DoRegular(Qs, currentLine_[index], GetPredictedValue(Ra, Rb, Rc), static_cast<Strategy*>(nullptr));
+            currentLine_[index] = static_cast<SAMPLE>(Ra);
             index++;
         }
         else
         {
             index += DoRunMode(index, static_cast<Strategy*>(nullptr));
+            Ra = currentLine_[index - 1];
             Rb = previousLine_[index - 1];
-            Rd = previousLine_[index];
+            Rd = index < width_ ? previousLine_[index] : Rb;
         }
     }
 }
@@ -687,6 +807,41 @@ void JlsCodec<Traits, Strategy>::DoLine(Triplet<SAMPLE>*)
 }
 
 
+/// <summary>Encodes/Decodes a scan line of quads (4 components, like RGBA or CMYK) in ILV_SAMPLE mode</summary>
+template<typename Traits, typename Strategy>
+void JlsCodec<Traits, Strategy>::DoLine(Quad<SAMPLE>*)
+{
+    int32_t index = 0;
+    while(index < width_)
+    {
+        const Quad<SAMPLE> Ra = currentLine_[index - 1];
+        const Quad<SAMPLE> Rc = previousLine_[index - 1];
+        const Quad<SAMPLE> Rb = previousLine_[index];
+        const Quad<SAMPLE> Rd = previousLine_[index + 1];
+
+        const int32_t Qs1 = ComputeContextID(QuantizeGradient(Rd.v1 - Rb.v1), QuantizeGradient(Rb.v1 - Rc.v1), QuantizeGradient(Rc.v1 - Ra.v1));
+        const int32_t Qs2 = ComputeContextID(QuantizeGradient(Rd.v2 - Rb.v2), QuantizeGradient(Rb.v2 - Rc.v2), QuantizeGradient(Rc.v2 - Ra.v2));
+        const int32_t Qs3 = ComputeContextID(QuantizeGradient(Rd.v3 - Rb.v3), QuantizeGradient(Rb.v3 - Rc.v3), QuantizeGradient(Rc.v3 - Ra.v3));
+        const int32_t Qs4 = ComputeContextID(QuantizeGradient(Rd.v4 - Rb.v4), QuantizeGradient(Rb.v4 - Rc.v4), QuantizeGradient(Rc.v4 - Ra.v4));
+
+        if (Qs1 == 0 && Qs2 == 0 && Qs3 == 0 && Qs4 == 0)
+        {
+            index += DoRunMode(index, static_cast<Strategy*>(nullptr));
+        }
+        else
+        {
+            Quad<SAMPLE> Rx;
+            Rx.v1 = DoRegular(Qs1, currentLine_[index].v1, GetPredictedValue(Ra.v1, Rb.v1, Rc.v1), static_cast<Strategy*>(nullptr));
+            Rx.v2 = DoRegular(Qs2, currentLine_[index].v2, GetPredictedValue(Ra.v2, Rb.v2, Rc.v2), static_cast<Strategy*>(nullptr));
+            Rx.v3 = DoRegular(Qs3, currentLine_[index].v3, GetPredictedValue(Ra.v3, Rb.v3, Rc.v3), static_cast<Strategy*>(nullptr));
+            Rx.v4 = DoRegular(Qs4, currentLine_[index].v4, GetPredictedValue(Ra.v4, Rb.v4, Rc.v4), static_cast<Strategy*>(nullptr));
+            currentLine_[index] = Rx;
+            index++;
+        }
+    }
+}
+
+
 // DoScan: Encodes or decodes a scan.
 // In ILV_SAMPLE mode, multiple components are handled in DoLine
 // In ILV_LINE mode, a call do DoLine is made for every component
@@ -695,44 +850,124 @@ void JlsCodec<Traits, Strategy>::DoLine(Triplet<SAMPLE>*)
 template<typename Traits, typename Strategy>
 void JlsCodec<Traits, Strategy>::DoScan()
 {
-    const int32_t pixelStride = width_ + 4;
+    StartScanLines();
+    while (line_ < Info().height)
+    {
+        DoScanLine();
+    }
+
+    Strategy::EndScan();
+}
+
+
+// Prepares the line buffers of a scan, DoScanLine codes its lines one by one.
+template<typename Traits, typename Strategy>
+void JlsCodec<Traits, Strategy>::StartScanLines()
+{
+    line_ = 0;
+    directDestination_ = DirectDestination(directStride_);
+    if (directDestination_)
+    {
+        lineBuffer_.assign(width_, PIXEL{});
+        previousLine_ = lineBuffer_.data();
+        leftOfPreviousLine_ = PIXEL{};
+        RUNindex_ = 0;
+        return;
+    }
+
     const int components = Info().interleaveMode == InterleaveMode::Line ? Info().components : 1;
+    lineBuffer_.assign(static_cast<size_t>(2) * components * (width_ + 4), PIXEL{});
+    componentRunIndex_.assign(components, 0);
+}
 
-    std::vector<PIXEL> vectmp(static_cast<size_t>(2) * components * pixelStride);
-    std::vector<int32_t> rgRUNindex(components);
 
-    for (int32_t line = 0; line < Info().height; ++line)
+template<typename Traits, typename Strategy>
+void JlsCodec<Traits, Strategy>::DoScanLine()
+{
+    const int32_t line = line_++;
+    const int32_t restartInterval = Info().restartInterval;
+    const bool restart = restartInterval != 0 && line != 0 && line % restartInterval == 0;
+    if (restart)
     {
-        previousLine_ = &vectmp[1];
-        currentLine_ = &vectmp[1 + static_cast<size_t>(components) * pixelStride];
-        if ((line & 1) == 1)
+        // After a RSTm marker the coding process starts again as if this line was the first line of the scan.
+        Strategy::EndRestartInterval((line / restartInterval - 1) % 8);
+        ResetParameters();
+    }
+
+    if (directDestination_)
+    {
+        // Single component lines are decoded directly into the destination rows: the previous output row is the previous line.
+        if (restart)
         {
-            std::swap(previousLine_, currentLine_);
+            previousLine_ = lineBuffer_.data();
+            leftOfPreviousLine_ = PIXEL{};
         }
 
-        Strategy::OnLineBegin(width_, currentLine_, pixelStride);
+        currentLine_ = reinterpret_cast<PIXEL*>(directDestination_ + line * directStride_);
+        DoLine(static_cast<PIXEL*>(nullptr)); // dummy argument for overload resolution
 
-        for (int component = 0; component < components; ++component)
-        {
-            RUNindex_ = rgRUNindex[component];
+        leftOfPreviousLine_ = previousLine_[0];
+        previousLine_ = currentLine_;
+        return;
+    }
 
-            // initialize edge pixels used for prediction
-            previousLine_[width_] = previousLine_[width_ - 1];
-            currentLine_[-1] = previousLine_[0];
-            DoLine(static_cast<PIXEL*>(nullptr)); // dummy argument for overload resolution
+    const int32_t pixelStride = width_ + 4;
+    const int components = static_cast<int>(componentRunIndex_.size());
 
-            rgRUNindex[component] = RUNindex_;
-            previousLine_ += pixelStride;
-            currentLine_ += pixelStride;
-        }
+    if (restart)
+    {
+        std::fill(lineBuffer_.begin(), lineBuffer_.end(), PIXEL{});
+        std::fill(componentRunIndex_.begin(), componentRunIndex_.end(), 0);
+    }
 
-        if (rect_.Y <= line && line < rect_.Y + rect_.Height)
-        {
-            Strategy::OnLineEnd(rect_.Width, currentLine_ + rect_.X - (static_cast<size_t>(components) * pixelStride), pixelStride);
-        }
+    previousLine_ = &lineBuffer_[1];
+    currentLine_ = &lineBuffer_[1 + static_cast<size_t>(components) * pixelStride];
+    if ((line & 1) == 1)
+    {
+        std::swap(previousLine_, currentLine_);
     }
 
-    Strategy::EndScan();
+    Strategy::OnLineBegin(width_, currentLine_, pixelStride);
+
+    for (int component = 0; component < components; ++component)
+    {
+        RUNindex_ = componentRunIndex_[component];
+
+        // initialize edge pixels used for prediction
+        previousLine_[width_] = previousLine_[width_ - 1];
+        currentLine_[-1] = previousLine_[0];
+        leftOfPreviousLine_ = previousLine_[-1];
+        DoLine(static_cast<PIXEL*>(nullptr)); // dummy argument for overload resolution
+
+        componentRunIndex_[component] = RUNindex_;
+        previousLine_ += pixelStride;
+        currentLine_ += pixelStride;
+    }
+
+    if (rect_.Y <= line && line < rect_.Y + rect_.Height)
+    {
+        Strategy::OnLineEnd(rect_.Width, currentLine_ + rect_.X - (static_cast<size_t>(components) * pixelStride), pixelStride);
+    }
+}
+
+
+// Returns the caller's buffer when single component lines can be decoded into it without an intermediate line buffer.
+// This requires that every decoded line of the scan is part of the output and that the rows are aligned for PIXEL access.
+template<typename Traits, typename Strategy>
+uint8_t* JlsCodec<Traits, Strategy>::DirectDestination(size_t& stride) noexcept
+{
+    if (!std::is_same<Strategy, DecoderStrategy>::value || !std::is_same<PIXEL, SAMPLE>::value)
+        return nullptr;
+
+    if (rect_.X != 0 || rect_.Width != width_ || rect_.Y > 0 || rect_.Y + rect_.Height < endLine_)
+        return nullptr;
+
+    uint8_t* destination = Strategy::processLine_->DirectLineBuffer(stride);
+    if (!destination || stride % sizeof(PIXEL) != 0 || stride < static_cast<size_t>(width_) * sizeof(PIXEL) ||
+        reinterpret_cast<uintptr_t>(destination) % alignof(PIXEL) != 0)
+        return nullptr;
+
+    return destination;
 }
 
 
@@ -740,6 +975,10 @@ void JlsCodec<Traits, Strategy>::DoScan()
 template<typename Traits, typename Strategy>
 std::unique_ptr<ProcessLine> JlsCodec<Traits, Strategy>::CreateProcess(ByteStreamInfo info)
 {
+    // A codec that is used for more than one scan reuses the object of the previous scan, when it can handle the data.
+    if (Strategy::processLine_ && Strategy::processLine_->Reset(info))
+        return std::move(Strategy::processLine_);
+
     if (!IsInterleaved())
     {
         return info.rawData ?
@@ -787,6 +1026,7 @@ size_t JlsCodec<Traits, Strategy>::EncodeScan(std::unique_ptr<ProcessLine> proce
     Strategy::processLine_ = std::move(processLine);
 
     Strategy::Init(compressedData);
+    ResetParameters();
     DoScan();
 
     return Strategy::GetLength();
@@ -802,10 +1042,47 @@ void JlsCodec<Traits, Strategy>::DecodeScan(std::unique_ptr<ProcessLine> process
     const uint8_t* compressedBytes = compressedData.rawData;
     rect_ = rect;
 
+    // The lines below the rectangle are not decoded, when the rest of the scan can be skipped in the encoded byte array.
+    endLine_ = compressedBytes ? std::min(rect_.Y + rect_.Height, Info().height) : Info().height;
+
     Strategy::Init(compressedData);
-    DoScan();
+    ResetParameters();
+    StartScanLines();
+    while (line_ < endLine_)
+    {
+        DoScanLine();
+    }
+
+    if (endLine_ < Info().height)
+    {
+        SkipBytes(compressedData, Strategy::FindScanEnd() - compressedBytes);
+        return;
+    }
+
+    Strategy::EndScan();
     SkipBytes(compressedData, Strategy::GetCurBytePos() - compressedBytes);
 }
+
+
+// Setup codec for decoding a scan line by line, for encoded data that is received in parts.
+template<typename Traits, typename Strategy>
+void JlsCodec<Traits, Strategy>::StartDecodeScan(std::unique_ptr<ProcessLine> processLine, const JlsRect& rect, ByteStreamInfo& compressedData)
+{
+    Strategy::processLine_ = std::move(processLine);
+    rect_ = rect;
+    endLine_ = Info().height;
+
+    Strategy::Init(compressedData);
+    ResetParameters();
+    StartScanLines();
+}
+
+
+template<typename Traits, typename Strategy>
+void JlsCodec<Traits, Strategy>::DecodeLine()
+{
+    DoScanLine();
+}
 MSVC_WARNING_UNSUPPRESS()
 
 // Initialize the codec data structures. Depends on JPEG-LS parameters like Threshold1-Threshold3.
@@ -816,16 +1093,25 @@ void JlsCodec<Traits, Strategy>::InitParams(int32_t t1, int32_t t2, int32_t t3,
     T2 = t2;
     T3 = t3;
 
+    resetValue_ = nReset;
+
     InitQuantizationLUT();
+    ResetParameters();
+}
+
 
+// Set the context variables to their initial state. Done at the start of a scan and at the start of every restart interval.
+template<typename Traits, typename Strategy>
+void JlsCodec<Traits, Strategy>::ResetParameters() noexcept
+{
     const JlsContext contextInitValue(std::max(2, (traits.RANGE + 32) / 64));
     for (auto& context : contexts_)
     {
         context = contextInitValue;
     }
 
-    contextRunmode_[0] = CContextRunMode(std::max(2, (traits.RANGE + 32) / 64), 0, nReset);
-    contextRunmode_[1] = CContextRunMode(std::max(2, (traits.RANGE + 32) / 64), 1, nReset);
+    contextRunmode_[0] = CContextRunMode(std::max(2, (traits.RANGE + 32) / 64), 0, resetValue_);
+    contextRunmode_[1] = CContextRunMode(std::max(2, (traits.RANGE + 32) / 64), 1, resetValue_);
     RUNindex_ = 0;
 }
 
@@ -101,13 +101,15 @@ struct Triplet
 };
 
 
-inline bool operator==(const Triplet<uint8_t>& lhs, const Triplet<uint8_t>& rhs) noexcept
+template<typename T>
+bool operator==(const Triplet<T>& lhs, const Triplet<T>& rhs) noexcept
 {
     return lhs.v1 == rhs.v1 && lhs.v2 == rhs.v2 && lhs.v3 == rhs.v3;
 }
 
 
-inline bool operator!=(const Triplet<uint8_t>& lhs, const Triplet<uint8_t>& rhs) noexcept
+template<typename T>
+bool operator!=(const Triplet<T>& lhs, const Triplet<T>& rhs) noexcept
 {
     return !(lhs == rhs);
 }
@@ -127,6 +129,12 @@ struct Quad final : Triplet<sample>
         A(static_cast<sample>(alpha))
     {
     }
+
+    Quad(int32_t x1, int32_t x2, int32_t x3, int32_t x4) noexcept :
+        Triplet<sample>(x1, x2, x3),
+        v4(static_cast<sample>(x4))
+    {
+    }
     MSVC_WARNING_UNSUPPRESS()
 
     union
@@ -137,6 +145,20 @@ struct Quad final : Triplet<sample>
 };
 
 
+template<typename sample>
+bool operator==(const Quad<sample>& lhs, const Quad<sample>& rhs) noexcept
+{
+    return lhs.v1 == rhs.v1 && lhs.v2 == rhs.v2 && lhs.v3 == rhs.v3 && lhs.v4 == rhs.v4;
+}
+
+
+template<typename sample>
+bool operator!=(const Quad<sample>& lhs, const Quad<sample>& rhs) noexcept
+{
+    return !(lhs == rhs);
+}
+
+
 template<int size>
 struct FromBigEndian final
 {
@@ -166,6 +188,29 @@ struct FromBigEndian<8> final
 };
 
 
+template<int size>
+struct ToBigEndian final
+{
+};
+
+
+template<>
+struct ToBigEndian<8> final
+{
+    FORCE_INLINE static void Write(uint8_t* buffer, uint64_t value) noexcept
+    {
+        buffer[0] = static_cast<uint8_t>(value >> 56u);
+        buffer[1] = static_cast<uint8_t>(value >> 48u);
+        buffer[2] = static_cast<uint8_t>(value >> 40u);
+        buffer[3] = static_cast<uint8_t>(value >> 32u);
+        buffer[4] = static_cast<uint8_t>(value >> 24u);
+        buffer[5] = static_cast<uint8_t>(value >> 16u);
+        buffer[6] = static_cast<uint8_t>(value >>  8u);
+        buffer[7] = static_cast<uint8_t>(value >>  0u);
+    }
+};
+
+
 inline void SkipBytes(ByteStreamInfo& streamInfo, std::size_t count) noexcept
 {
     if (!streamInfo.rawData)
@@ -38,6 +38,7 @@ using charls::DefaultTraits;
 using charls::LosslessTraits;
 using charls::jpegls_errc;
 using charls::TransformRgbToBgr;
+using charls::Triplet;
 using charls::InterleaveMode;
 using charls::log_2;
 
@@ -323,6 +324,1254 @@ void TestDecodeRect()
 }
 
 
+void TestRestartIntervalRoundTrip(const vector<uint8_t>& pixels, const JlsParameters& params)
+{
+    vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+    size_t bytesWritten{};
+    error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+    Assert::IsTrue(!error);
+    encoded.resize(bytesWritten);
+
+    JlsParameters header{};
+    error = JpegLsReadHeader(encoded.data(), encoded.size(), &header, nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(header.restartInterval == params.restartInterval);
+
+    // Restart intervals encoded concurrently are concatenated with RSTm markers and should be identical.
+    JlsParameters encodeParams{params};
+    encodeParams.threadCount = 4;
+    vector<uint8_t> encodedConcurrently(pixels.size() * 2 + 1024);
+    error = JpegLsEncode(encodedConcurrently.data(), encodedConcurrently.size(), &bytesWritten, pixels.data(), pixels.size(), &encodeParams, nullptr);
+    Assert::IsTrue(!error);
+    encodedConcurrently.resize(bytesWritten);
+    Assert::IsTrue(encoded == encodedConcurrently);
+
+    // Every scan has a RSTm marker between its restart intervals. The entropy coded data never contains 0xFF followed by a byte >= 0x80.
+    const int scanCount = params.interleaveMode == InterleaveMode::None ? params.components : 1;
+    const int intervalCount = (params.height + params.restartInterval - 1) / params.restartInterval;
+    int markerCount{};
+    int markerCountInScan{};
+    for (size_t i = 0; i + 1 < encoded.size(); ++i)
+    {
+        if (encoded[i] == 0xFF && encoded[i + 1] == 0xDA)
+        {
+            // The numbering of the RSTm markers starts again at RST0 in every scan.
+            markerCountInScan = 0;
+        }
+        else if (encoded[i] == 0xFF && encoded[i + 1] >= 0xD0 && encoded[i + 1] <= 0xD7)
+        {
+            Assert::IsTrue(encoded[i + 1] == 0xD0 + markerCountInScan % 8);
+            ++markerCountInScan;
+            ++markerCount;
+        }
+    }
+    Assert::IsTrue(markerCount == scanCount * (intervalCount - 1));
+
+    vector<uint8_t> decoded(pixels.size());
+    error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+
+    if (scanCount == 1)
+    {
+        // Note: decoding multiple scans from a stream source is not supported.
+        std::basic_stringbuf<char> encodedStream(string(encoded.cbegin(), encoded.cend()), ios::in);
+        vector<uint8_t> decodedFromStream(pixels.size());
+        error = JpegLsDecodeStream(FromByteArray(decodedFromStream.data(), decodedFromStream.size()), {&encodedStream, nullptr, 0}, nullptr);
+        Assert::IsTrue(!error);
+        Assert::IsTrue(decoded == decodedFromStream);
+    }
+
+    // Restart intervals decoded concurrently should give the same result, also when only a part of the image is decoded.
+    JlsParameters threadParams{};
+    threadParams.threadCount = 4;
+    vector<uint8_t> decodedConcurrently(pixels.size());
+    error = JpegLsDecode(decodedConcurrently.data(), decodedConcurrently.size(), encoded.data(), encoded.size(), &threadParams, nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(decoded == decodedConcurrently);
+
+    const JlsRect rect{params.width / 4, params.height / 3, params.width / 2, params.height / 3};
+    vector<uint8_t> decodedRect(pixels.size());
+    error = JpegLsDecodeRect(decodedRect.data(), decodedRect.size(), encoded.data(), encoded.size(), rect, nullptr, nullptr);
+    Assert::IsTrue(!error);
+    vector<uint8_t> decodedRectConcurrently(pixels.size());
+    error = JpegLsDecodeRect(decodedRectConcurrently.data(), decodedRectConcurrently.size(), encoded.data(), encoded.size(), rect, &threadParams, nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(decodedRect == decodedRectConcurrently);
+
+    const int bytesPerSample = params.bitsPerSample > 8 ? 2 : 1;
+    for (size_t i = 0; i < decoded.size(); i += bytesPerSample)
+    {
+        const int expected = bytesPerSample == 1 ? pixels[i] : pixels[i] | pixels[i + 1] << 8;
+        const int actual = bytesPerSample == 1 ? decoded[i] : decoded[i] | decoded[i + 1] << 8;
+        Assert::IsTrue(std::abs(expected - actual) <= params.allowedLossyError);
+    }
+}
+
+
+void TestRestartInterval()
+{
+    JlsParameters params{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &params);
+    vector<uint8_t> lena(static_cast<size_t>(params.width) * params.height);
+    error_code error = JpegLsDecode(lena.data(), lena.size(), encodedLena.data(), encodedLena.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+
+    params.stride = 0;
+    for (const int restartInterval : {1, 7, 8, 511, 512})
+    {
+        params.restartInterval = restartInterval;
+        params.allowedLossyError = 0;
+        TestRestartIntervalRoundTrip(lena, params);
+
+        params.allowedLossyError = 3;
+        TestRestartIntervalRoundTrip(lena, params);
+    }
+
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    colorParams.restartInterval = 10;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+    for (const auto interleaveMode : {InterleaveMode::None, InterleaveMode::Line, InterleaveMode::Sample})
+    {
+        colorParams.interleaveMode = interleaveMode;
+        TestRestartIntervalRoundTrip(color, colorParams);
+    }
+
+    JlsParameters noiseParams{};
+    noiseParams.width = 100;
+    noiseParams.height = 100;
+    noiseParams.bitsPerSample = 12;
+    noiseParams.components = 1;
+    noiseParams.restartInterval = 3;
+    TestRestartIntervalRoundTrip(MakeSomeNoise16bit(static_cast<size_t>(noiseParams.width) * noiseParams.height, noiseParams.bitsPerSample, 21344), noiseParams);
+
+    // Encoded data that ends in the middle of the restart intervals should be reported, also when decoded concurrently.
+    params.restartInterval = 7;
+    params.allowedLossyError = 0;
+    vector<uint8_t> encoded(lena.size() + 1024);
+    size_t bytesWritten{};
+    error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, lena.data(), lena.size(), &params, nullptr);
+    Assert::IsTrue(!error);
+    encoded.resize(bytesWritten / 2);
+
+    JlsParameters threadParams{};
+    threadParams.threadCount = 2;
+    vector<uint8_t> decoded(lena.size());
+    error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), &threadParams, nullptr);
+    Assert::IsTrue(error == jpegls_errc::source_buffer_too_small);
+
+    // A RSTm marker in front of the frame (outside the encoded data of a scan) is not valid.
+    for (const uint8_t restartMarker : {0xD0, 0xD3, 0xD7})
+    {
+        vector<uint8_t> misplaced{encoded};
+        misplaced.insert(misplaced.begin() + 2, {0xFF, restartMarker});
+        error = JpegLsReadHeader(misplaced.data(), misplaced.size(), &params, nullptr);
+        Assert::IsTrue(error == jpegls_errc::restart_marker_not_found);
+    }
+}
+
+
+void TestDecodeComponentsConcurrently()
+{
+    JlsParameters params{};
+    params.width = 256;
+    params.height = 256;
+    params.bitsPerSample = 8;
+    params.components = 3;
+    params.interleaveMode = InterleaveMode::None;
+    const vector<uint8_t> pixels = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+    size_t bytesWritten{};
+    error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+    Assert::IsTrue(!error);
+    encoded.resize(bytesWritten);
+
+    vector<uint8_t> decoded(pixels.size());
+    error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+
+    JlsParameters threadParams{};
+    threadParams.threadCount = 3;
+    vector<uint8_t> decodedConcurrently(pixels.size());
+    error = JpegLsDecode(decodedConcurrently.data(), decodedConcurrently.size(), encoded.data(), encoded.size(), &threadParams, nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(decoded == decodedConcurrently);
+
+    const JlsRect rect{10, 20, 100, 50};
+    vector<uint8_t> decodedRect(pixels.size());
+    error = JpegLsDecodeRect(decodedRect.data(), decodedRect.size(), encoded.data(), encoded.size(), rect, nullptr, nullptr);
+    Assert::IsTrue(!error);
+    vector<uint8_t> decodedRectConcurrently(pixels.size());
+    error = JpegLsDecodeRect(decodedRectConcurrently.data(), decodedRectConcurrently.size(), encoded.data(), encoded.size(), rect, &threadParams, nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(decodedRect == decodedRectConcurrently);
+
+    // A damaged scan should be reported as it is when decoding on a single thread.
+    encoded[encoded.size() / 2] = 0xFF;
+    encoded[encoded.size() / 2 + 1] = 0xC0;
+    error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), nullptr, nullptr);
+    Assert::IsTrue(static_cast<bool>(error));
+    error = JpegLsDecode(decodedConcurrently.data(), decodedConcurrently.size(), encoded.data(), encoded.size(), &threadParams, nullptr);
+    Assert::IsTrue(static_cast<bool>(error));
+}
+
+
+void TestEncodeComponentsConcurrently()
+{
+    JlsParameters params{};
+    params.width = 256;
+    params.height = 256;
+    params.bitsPerSample = 8;
+    params.components = 3;
+    params.interleaveMode = InterleaveMode::None;
+    const vector<uint8_t> pixels = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    for (const int restartInterval : {0, 10})
+    {
+        params.restartInterval = restartInterval;
+        params.threadCount = 0;
+        vector<uint8_t> encoded(pixels.size() * 2);
+        size_t bytesWritten{};
+        error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+        encoded.resize(bytesWritten);
+
+        // The scans encoded concurrently are written in component order and should be identical.
+        params.threadCount = 3;
+        vector<uint8_t> encodedConcurrently(pixels.size() * 2);
+        error = JpegLsEncode(encodedConcurrently.data(), encodedConcurrently.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+        encodedConcurrently.resize(bytesWritten);
+        Assert::IsTrue(encoded == encodedConcurrently);
+
+        vector<uint8_t> tooSmall(pixels.size());
+        const size_t tooSmallSize = encoded.size() - 1;
+        error = JpegLsEncode(tooSmall.data(), tooSmallSize, &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+        Assert::IsTrue(error == jpegls_errc::destination_buffer_too_small);
+    }
+}
+
+
+void TestDecodeIntoDestinationRows()
+{
+    // Single component lines are decoded directly into the rows of a destination buffer. Decoding to a stream passes every
+    // line through the line buffers of the codec and should give the same result.
+    JlsParameters params{};
+    params.width = 67;
+    params.height = 23;
+    params.components = 1;
+
+    for (const int bitsPerSample : {8, 16})
+    {
+        const int bytesPerSample = bitsPerSample > 8 ? 2 : 1;
+        const int maximumValue = (1 << bitsPerSample) - 1;
+        const size_t bytesPerLine = static_cast<size_t>(params.width) * bytesPerSample;
+
+        // Flat areas are coded in run mode, which also starts and ends at the edges of a line.
+        srand(bitsPerSample);
+        vector<uint8_t> pixels(bytesPerLine * params.height);
+        for (int y = 0; y < params.height; ++y)
+        {
+            for (int x = 0; x < params.width; ++x)
+            {
+                const int value = x < 12 || x > 50 || y % 5 == 0 ? y * 3 : rand() & maximumValue;
+                const size_t index = static_cast<size_t>(y) * bytesPerLine + static_cast<size_t>(x) * bytesPerSample;
+                pixels[index] = static_cast<uint8_t>(value);
+                if (bytesPerSample == 2)
+                {
+                    pixels[index + 1] = static_cast<uint8_t>(value >> 8);
+                }
+            }
+        }
+
+        params.bitsPerSample = bitsPerSample;
+        for (const int allowedLossyError : {0, 2})
+        {
+            for (const int restartInterval : {0, 5})
+            {
+                params.allowedLossyError = allowedLossyError;
+                params.restartInterval = restartInterval;
+                vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+                size_t bytesWritten{};
+                error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+                Assert::IsTrue(!error);
+                encoded.resize(bytesWritten);
+
+                vector<uint8_t> decoded(pixels.size());
+                error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), nullptr, nullptr);
+                Assert::IsTrue(!error);
+                if (allowedLossyError == 0)
+                {
+                    Assert::IsTrue(decoded == pixels);
+                }
+
+                std::basic_stringbuf<char> encodedStream(string(encoded.cbegin(), encoded.cend()), ios::in);
+                vector<uint8_t> decodedFromStream(pixels.size());
+                error = JpegLsDecodeStream(FromByteArray(decodedFromStream.data(), decodedFromStream.size()), {&encodedStream, nullptr, 0}, nullptr);
+                Assert::IsTrue(!error);
+                Assert::IsTrue(decoded == decodedFromStream);
+
+                // Padded rows are decoded directly when they stay aligned, the padding itself should not be written.
+                for (const int padding : {bytesPerSample, 1})
+                {
+                    JlsParameters strideParams{};
+                    strideParams.stride = static_cast<int>(bytesPerLine) + padding;
+                    vector<uint8_t> decodedWithStride(static_cast<size_t>(strideParams.stride) * params.height, 0x5A);
+                    error = JpegLsDecode(decodedWithStride.data(), decodedWithStride.size(), encoded.data(), encoded.size(), &strideParams, nullptr);
+                    Assert::IsTrue(!error);
+
+                    for (int y = 0; y < params.height; ++y)
+                    {
+                        const auto row = decodedWithStride.cbegin() + static_cast<ptrdiff_t>(y) * strideParams.stride;
+                        Assert::IsTrue(std::equal(row, row + static_cast<ptrdiff_t>(bytesPerLine), decoded.cbegin() + static_cast<ptrdiff_t>(y * bytesPerLine)));
+                        Assert::IsTrue(std::all_of(row + static_cast<ptrdiff_t>(bytesPerLine), row + strideParams.stride, [](uint8_t value) { return value == 0x5A; }));
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+void TestCodecSessions()
+{
+    JlsParameters lenaParams{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &lenaParams);
+    vector<uint8_t> lena(static_cast<size_t>(lenaParams.width) * lenaParams.height);
+    error_code error = JpegLsDecode(lena.data(), lena.size(), encodedLena.data(), encodedLena.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+    lenaParams.stride = 0;
+
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    JlsParameters noiseParams{};
+    noiseParams.width = 100;
+    noiseParams.height = 100;
+    noiseParams.bitsPerSample = 12;
+    noiseParams.components = 1;
+    noiseParams.restartInterval = 7;
+    const vector<uint8_t> noise = MakeSomeNoise16bit(static_cast<size_t>(noiseParams.width) * noiseParams.height, noiseParams.bitsPerSample, 21344);
+
+    struct Image
+    {
+        const vector<uint8_t>& pixels;
+        JlsParameters params;
+    };
+    vector<Image> images{{lena, lenaParams}, {lena, lenaParams}, {color, colorParams}, {noise, noiseParams}};
+    images.push_back(images[2]);
+    images.back().params.interleaveMode = InterleaveMode::Line;
+    images.push_back(images[2]);
+    images.back().params.interleaveMode = InterleaveMode::Sample;
+    images.push_back(images[0]);
+    images.back().params.allowedLossyError = 2;
+
+    // The encoder and decoder reuse their codec when the parameters are the same and should give the same result as a new codec.
+    charls_jpegls_encoder* encoder = charls_jpegls_encoder_create();
+    charls_jpegls_decoder* decoder = charls_jpegls_decoder_create();
+    Assert::IsTrue(encoder && decoder);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (const Image& image : images)
+        {
+            vector<uint8_t> encoded(image.pixels.size() * 2 + 1024);
+            size_t bytesWritten{};
+            error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, image.pixels.data(), image.pixels.size(), &image.params, nullptr);
+            Assert::IsTrue(!error);
+            encoded.resize(bytesWritten);
+
+            vector<uint8_t> encodedBySession(image.pixels.size() * 2 + 1024);
+            error = charls_jpegls_encoder_encode(encoder, encodedBySession.data(), encodedBySession.size(), &bytesWritten, image.pixels.data(), image.pixels.size(), &image.params);
+            Assert::IsTrue(!error);
+            encodedBySession.resize(bytesWritten);
+            Assert::IsTrue(encoded == encodedBySession);
+
+            vector<uint8_t> decoded(image.pixels.size());
+            error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), nullptr, nullptr);
+            Assert::IsTrue(!error);
+
+            vector<uint8_t> decodedBySession(image.pixels.size());
+            error = charls_jpegls_decoder_decode(decoder, decodedBySession.data(), decodedBySession.size(), encoded.data(), encoded.size(), nullptr);
+            Assert::IsTrue(!error);
+            Assert::IsTrue(decoded == decodedBySession);
+        }
+    }
+
+    // A failed call should not affect the next one.
+    vector<uint8_t> tooSmall(10);
+    size_t bytesWritten{};
+    error = charls_jpegls_encoder_encode(encoder, tooSmall.data(), tooSmall.size(), &bytesWritten, lena.data(), lena.size(), &lenaParams);
+    Assert::IsTrue(error == jpegls_errc::destination_buffer_too_small);
+    vector<uint8_t> encoded(lena.size() * 2);
+    error = charls_jpegls_encoder_encode(encoder, encoded.data(), encoded.size(), &bytesWritten, lena.data(), lena.size(), &lenaParams);
+    Assert::IsTrue(!error);
+    encoded.resize(bytesWritten);
+
+    vector<uint8_t> decoded(lena.size());
+    error = charls_jpegls_decoder_decode(decoder, decoded.data(), decoded.size(), encoded.data(), encoded.size() / 2, nullptr);
+    Assert::IsTrue(static_cast<bool>(error));
+    error = charls_jpegls_decoder_decode(decoder, decoded.data(), decoded.size(), encoded.data(), encoded.size(), nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(decoded == lena);
+
+    charls_jpegls_encoder_destroy(encoder);
+    charls_jpegls_decoder_destroy(decoder);
+}
+
+
+void TestDecodeBatch()
+{
+    JlsParameters lenaParams{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &lenaParams);
+    const size_t lenaSize = static_cast<size_t>(lenaParams.width) * lenaParams.height;
+
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    JlsParameters noiseParams{};
+    noiseParams.width = 100;
+    noiseParams.height = 100;
+    noiseParams.bitsPerSample = 12;
+    noiseParams.components = 1;
+    const vector<uint8_t> noise = MakeSomeNoise16bit(static_cast<size_t>(noiseParams.width) * noiseParams.height, noiseParams.bitsPerSample, 21344);
+
+    vector<vector<uint8_t>> sources{encodedLena};
+    vector<size_t> destinationSizes{lenaSize};
+    const auto addEncoded = [&](const vector<uint8_t>& pixels, const JlsParameters& params)
+    {
+        vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+        size_t bytesWritten{};
+        const error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+        encoded.resize(bytesWritten);
+        sources.push_back(encoded);
+        destinationSizes.push_back(pixels.size());
+    };
+    for (const auto interleaveMode : {InterleaveMode::None, InterleaveMode::Line, InterleaveMode::Sample})
+    {
+        colorParams.interleaveMode = interleaveMode;
+        addEncoded(color, colorParams);
+    }
+    addEncoded(noise, noiseParams);
+    noiseParams.allowedLossyError = 3;
+    addEncoded(noise, noiseParams);
+
+    // A failing image should only affect its own result.
+    sources.emplace_back(encodedLena.begin(), encodedLena.begin() + encodedLena.size() / 2);
+    destinationSizes.push_back(lenaSize);
+    sources.push_back(encodedLena);
+    destinationSizes.push_back(lenaSize - 1);
+    sources.push_back(sources[4]);
+    destinationSizes.push_back(destinationSizes[4]);
+
+    vector<vector<uint8_t>> expected;
+    vector<jpegls_errc> expectedResults;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        expected.emplace_back(destinationSizes[i]);
+        expectedResults.push_back(JpegLsDecode(expected[i].data(), expected[i].size(), sources[i].data(), sources[i].size(), nullptr, nullptr));
+    }
+    Assert::IsTrue(expectedResults[6] != jpegls_errc::success && expectedResults[7] == jpegls_errc::destination_buffer_too_small);
+
+    charls_jpegls_decoder* decoders[]{charls_jpegls_decoder_create(), charls_jpegls_decoder_create()};
+    Assert::IsTrue(decoders[0] && decoders[1]);
+
+    // Temporary decoders on 3 threads and twice the same 2 decoders, which keep their codecs between the batches.
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        vector<vector<uint8_t>> destinations;
+        vector<JlsDecodeBatchItem> items;
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            destinations.emplace_back(destinationSizes[i]);
+            items.push_back({sources[i].data(), sources[i].size(), destinations[i].data(), destinations[i].size()});
+        }
+
+        vector<jpegls_errc> results(items.size(), jpegls_errc::unexpected_failure);
+        const jpegls_errc result = pass == 0 ? charls_jpegls_decode_batch(nullptr, 3, items.data(), items.size(), results.data()) :
+                                               charls_jpegls_decode_batch(decoders, 2, items.data(), items.size(), results.data());
+        Assert::IsTrue(result == expectedResults[6]);
+        Assert::IsTrue(results == expectedResults);
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            Assert::IsTrue(results[i] != jpegls_errc::success || destinations[i] == expected[i]);
+        }
+    }
+
+    jpegls_errc result{};
+    Assert::IsTrue(charls_jpegls_decode_batch(nullptr, 0, nullptr, 0, nullptr) == jpegls_errc::success);
+    Assert::IsTrue(charls_jpegls_decode_batch(nullptr, 0, nullptr, 1, &result) == jpegls_errc::invalid_argument);
+    const JlsDecodeBatchItem item{encodedLena.data(), encodedLena.size(), nullptr, 0};
+    charls_jpegls_decoder_destroy(decoders[1]);
+    decoders[1] = nullptr;
+    Assert::IsTrue(charls_jpegls_decode_batch(decoders, 2, &item, 1, &result) == jpegls_errc::invalid_argument);
+
+    charls_jpegls_decoder_destroy(decoders[0]);
+}
+
+
+void TestPushDecoder()
+{
+    JlsParameters lenaParams{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &lenaParams);
+
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    JlsParameters noiseParams{};
+    noiseParams.width = 100;
+    noiseParams.height = 100;
+    noiseParams.bitsPerSample = 12;
+    noiseParams.components = 1;
+    noiseParams.restartInterval = 7;
+    const vector<uint8_t> noise = MakeSomeNoise16bit(static_cast<size_t>(noiseParams.width) * noiseParams.height, noiseParams.bitsPerSample, 21344);
+
+    vector<vector<uint8_t>> sources{encodedLena};
+    const auto addEncoded = [&](const vector<uint8_t>& pixels, const JlsParameters& params)
+    {
+        vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+        size_t bytesWritten{};
+        const error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+        encoded.resize(bytesWritten);
+        sources.push_back(encoded);
+    };
+    for (const auto interleaveMode : {InterleaveMode::None, InterleaveMode::Line, InterleaveMode::Sample})
+    {
+        colorParams.interleaveMode = interleaveMode;
+        addEncoded(color, colorParams);
+    }
+    addEncoded(noise, noiseParams);
+    noiseParams.allowedLossyError = 3;
+    addEncoded(noise, noiseParams);
+
+    for (const vector<uint8_t>& source : sources)
+    {
+        JlsParameters params{};
+        error_code error = JpegLsReadHeader(source.data(), source.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+        const size_t size = static_cast<size_t>(params.height) * params.stride * (params.interleaveMode == InterleaveMode::None ? params.components : 1);
+        const size_t lineCount = static_cast<size_t>(params.height) * (params.interleaveMode == InterleaveMode::None ? params.components : 1);
+        vector<uint8_t> expected(size);
+        error = JpegLsDecode(expected.data(), expected.size(), source.data(), source.size(), nullptr, nullptr);
+        Assert::IsTrue(!error);
+
+        // Parts of 1 byte, parts of different sizes and the destination set before or after the header has been received.
+        for (const size_t partSize : {size_t{1}, size_t{97}, size_t{1000}})
+        {
+            charls_jpegls_push_decoder* decoder = charls_jpegls_push_decoder_create();
+            Assert::IsTrue(decoder != nullptr);
+            vector<uint8_t> destination(size);
+            if (partSize != 97)
+            {
+                error = charls_jpegls_push_decoder_set_destination(decoder, destination.data(), destination.size());
+                Assert::IsTrue(!error);
+            }
+
+            size_t decodedLineCount{};
+            bool linesDecodedBeforeEnd{};
+            for (size_t position = 0; position < source.size(); position += partSize)
+            {
+                error = charls_jpegls_push_decoder_feed(decoder, source.data() + position, std::min(partSize, source.size() - position));
+                Assert::IsTrue(!error);
+
+                JlsParameters header{};
+                if (charls_jpegls_push_decoder_read_header(decoder, &header) == jpegls_errc::success && partSize == 97 && position < partSize * 5)
+                {
+                    Assert::IsTrue(header.width == params.width && header.height == params.height && header.components == params.components);
+                    error = charls_jpegls_push_decoder_set_destination(decoder, destination.data(), destination.size());
+                    Assert::IsTrue(!error);
+                }
+
+                size_t lines{};
+                error = charls_jpegls_push_decoder_get_line_count(decoder, &lines);
+                Assert::IsTrue(!error && lines >= decodedLineCount);
+                decodedLineCount = lines;
+                linesDecodedBeforeEnd = linesDecodedBeforeEnd || (lines != 0 && position + partSize < source.size());
+            }
+
+            Assert::IsTrue(decodedLineCount == lineCount);
+            Assert::IsTrue(linesDecodedBeforeEnd || partSize * 4 > source.size());
+            Assert::IsTrue(destination == expected);
+            charls_jpegls_push_decoder_destroy(decoder);
+        }
+    }
+
+    // A decoder that fails keeps reporting the error.
+    charls_jpegls_push_decoder* decoder = charls_jpegls_push_decoder_create();
+    vector<uint8_t> destination(static_cast<size_t>(lenaParams.width) * lenaParams.height - 1);
+    error_code error = charls_jpegls_push_decoder_set_destination(decoder, destination.data(), destination.size());
+    Assert::IsTrue(!error);
+    error = charls_jpegls_push_decoder_feed(decoder, encodedLena.data(), encodedLena.size());
+    Assert::IsTrue(error == jpegls_errc::destination_buffer_too_small);
+    error = charls_jpegls_push_decoder_feed(decoder, encodedLena.data(), encodedLena.size());
+    Assert::IsTrue(error == jpegls_errc::destination_buffer_too_small);
+    charls_jpegls_push_decoder_destroy(decoder);
+}
+
+
+struct LineSinkRows
+{
+    vector<uint8_t> pixels;
+    size_t rowSize;
+    int32_t height;
+    size_t rowCount;
+};
+
+
+void CHARLS_API_CALLING_CONVENTION CopyLineSinkRow(void* context, int32_t row, int32_t component, const void* pixels, size_t size)
+{
+    LineSinkRows& rows = *static_cast<LineSinkRows*>(context);
+    Assert::IsTrue(size == rows.rowSize && row >= 0 && row < rows.height);
+
+    const size_t offset = (static_cast<size_t>(component) * rows.height + row) * rows.rowSize;
+    Assert::IsTrue(offset + size <= rows.pixels.size());
+    std::copy_n(static_cast<const uint8_t*>(pixels), size, rows.pixels.begin() + offset);
+    ++rows.rowCount;
+}
+
+
+void TestLineSink()
+{
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    JlsParameters noiseParams{};
+    noiseParams.width = 100;
+    noiseParams.height = 100;
+    noiseParams.bitsPerSample = 16;
+    noiseParams.components = 1;
+    const vector<uint8_t> noise = MakeSomeNoise16bit(static_cast<size_t>(noiseParams.width) * noiseParams.height, noiseParams.bitsPerSample, 21344);
+
+    vector<vector<uint8_t>> sources{ReadFile("test/lena8b.jls")};
+    const auto addEncoded = [&](const vector<uint8_t>& pixels, const JlsParameters& params)
+    {
+        vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+        size_t bytesWritten{};
+        const error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+        encoded.resize(bytesWritten);
+        sources.push_back(encoded);
+    };
+    for (const auto interleaveMode : {InterleaveMode::None, InterleaveMode::Line, InterleaveMode::Sample})
+    {
+        colorParams.interleaveMode = interleaveMode;
+        addEncoded(color, colorParams);
+    }
+    colorParams.colorTransformation = charls::ColorTransformation::HP1;
+    addEncoded(color, colorParams);
+    addEncoded(noise, noiseParams);
+
+    for (const vector<uint8_t>& source : sources)
+    {
+        JlsParameters params{};
+        error_code error = JpegLsReadHeader(source.data(), source.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+        const int32_t planeCount = params.interleaveMode == InterleaveMode::None ? params.components : 1;
+        vector<uint8_t> expected(static_cast<size_t>(params.height) * params.stride * planeCount);
+        error = JpegLsDecode(expected.data(), expected.size(), source.data(), source.size(), nullptr, nullptr);
+        Assert::IsTrue(!error);
+
+        // Every row is passed once, in the format of the destination rows.
+        LineSinkRows rows{vector<uint8_t>(expected.size()), static_cast<size_t>(params.stride), params.height, 0};
+        error = charls_jpegls_decode_to_line_sink(source.data(), source.size(), nullptr, CopyLineSinkRow, &rows);
+        Assert::IsTrue(!error);
+        Assert::IsTrue(rows.rowCount == static_cast<size_t>(params.height) * planeCount);
+        Assert::IsTrue(rows.pixels == expected);
+
+        // The push decoder passes the rows as the encoded data is received.
+        LineSinkRows pushedRows{vector<uint8_t>(expected.size()), static_cast<size_t>(params.stride), params.height, 0};
+        charls_jpegls_push_decoder* decoder = charls_jpegls_push_decoder_create();
+        error = charls_jpegls_push_decoder_set_line_sink(decoder, CopyLineSinkRow, &pushedRows);
+        Assert::IsTrue(!error);
+        for (size_t position = 0; position < source.size(); position += 333)
+        {
+            error = charls_jpegls_push_decoder_feed(decoder, source.data() + position, std::min(size_t{333}, source.size() - position));
+            Assert::IsTrue(!error);
+        }
+        Assert::IsTrue(pushedRows.rowCount == rows.rowCount);
+        Assert::IsTrue(pushedRows.pixels == expected);
+
+        vector<uint8_t> destination(expected.size());
+        error = charls_jpegls_push_decoder_set_destination(decoder, destination.data(), destination.size());
+        Assert::IsTrue(error == jpegls_errc::invalid_argument);
+        charls_jpegls_push_decoder_destroy(decoder);
+    }
+}
+
+
+struct RowSourceImage
+{
+    const vector<uint8_t>& pixels;
+    size_t rowSize;
+    int32_t height;
+    int32_t lastRow;
+    vector<uint8_t> encoded;
+    size_t maximumEncodedSize;
+};
+
+
+int32_t CHARLS_API_CALLING_CONVENTION ReadSourceRow(void* context, int32_t row, int32_t component, void* pixels, size_t size)
+{
+    const RowSourceImage& image = *static_cast<RowSourceImage*>(context);
+    Assert::IsTrue(size == image.rowSize && row >= 0 && row < image.height);
+    if (row > image.lastRow)
+        return 1;
+
+    const size_t offset = (static_cast<size_t>(component) * image.height + row) * image.rowSize;
+    Assert::IsTrue(offset + size <= image.pixels.size());
+    std::copy_n(image.pixels.begin() + offset, size, static_cast<uint8_t*>(pixels));
+    return 0;
+}
+
+
+int32_t CHARLS_API_CALLING_CONVENTION WriteEncodedBytes(void* context, const void* bytes, size_t size)
+{
+    RowSourceImage& image = *static_cast<RowSourceImage*>(context);
+    if (image.encoded.size() + size > image.maximumEncodedSize)
+        return 1;
+
+    image.encoded.insert(image.encoded.end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + size);
+    return 0;
+}
+
+
+void TestEncodeRows()
+{
+    JlsParameters lenaParams{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &lenaParams);
+    vector<uint8_t> lena(static_cast<size_t>(lenaParams.width) * lenaParams.height);
+    error_code error = JpegLsDecode(lena.data(), lena.size(), encodedLena.data(), encodedLena.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+    lenaParams.stride = 0;
+
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    JlsParameters noiseParams{};
+    noiseParams.width = 100;
+    noiseParams.height = 100;
+    noiseParams.bitsPerSample = 16;
+    noiseParams.components = 1;
+    noiseParams.restartInterval = 7;
+    const vector<uint8_t> noise = MakeSomeNoise16bit(static_cast<size_t>(noiseParams.width) * noiseParams.height, noiseParams.bitsPerSample, 21344);
+
+    struct Image
+    {
+        const vector<uint8_t>& pixels;
+        JlsParameters params;
+    };
+    vector<Image> images{{lena, lenaParams}, {color, colorParams}, {color, colorParams}, {color, colorParams}, {noise, noiseParams}};
+    images[2].params.interleaveMode = InterleaveMode::Line;
+    images[3].params.interleaveMode = InterleaveMode::Sample;
+    images[3].params.colorTransformation = charls::ColorTransformation::HP1;
+    images.push_back(images[0]);
+    images.back().params.allowedLossyError = 2;
+
+    charls_jpegls_encoder* encoder = charls_jpegls_encoder_create();
+    Assert::IsTrue(encoder != nullptr);
+
+    // The encoded bytes should be the same as the bytes encoded from a source byte array.
+    for (const Image& image : images)
+    {
+        vector<uint8_t> expected(image.pixels.size() * 2 + 1024);
+        size_t bytesWritten{};
+        error = JpegLsEncode(expected.data(), expected.size(), &bytesWritten, image.pixels.data(), image.pixels.size(), &image.params, nullptr);
+        Assert::IsTrue(!error);
+        expected.resize(bytesWritten);
+
+        const int32_t planeCount = image.params.interleaveMode == InterleaveMode::None ? image.params.components : 1;
+        const size_t rowSize = image.pixels.size() / (static_cast<size_t>(image.params.height) * planeCount);
+        RowSourceImage rowSource{image.pixels, rowSize, image.params.height, image.params.height, {}, expected.size()};
+        error = charls_jpegls_encoder_encode_rows(encoder, ReadSourceRow, WriteEncodedBytes, &rowSource, &image.params, &bytesWritten);
+        Assert::IsTrue(!error);
+        Assert::IsTrue(bytesWritten == expected.size());
+        Assert::IsTrue(rowSource.encoded == expected);
+    }
+
+    // The row source and the byte sink can stop the encoding.
+    RowSourceImage rowSource{lena, static_cast<size_t>(lenaParams.width), lenaParams.height, 10, {}, lena.size()};
+    size_t bytesWritten{};
+    error = charls_jpegls_encoder_encode_rows(encoder, ReadSourceRow, WriteEncodedBytes, &rowSource, &lenaParams, &bytesWritten);
+    Assert::IsTrue(error == jpegls_errc::source_buffer_too_small);
+
+    rowSource.lastRow = lenaParams.height;
+    rowSource.encoded.clear();
+    rowSource.maximumEncodedSize = 1000;
+    error = charls_jpegls_encoder_encode_rows(encoder, ReadSourceRow, WriteEncodedBytes, &rowSource, &lenaParams, &bytesWritten);
+    Assert::IsTrue(error == jpegls_errc::destination_buffer_too_small);
+
+    charls_jpegls_encoder_destroy(encoder);
+}
+
+
+void TestEncodeDecodeFile()
+{
+    JlsParameters params{};
+    params.width = 256;
+    params.height = 256;
+    params.bitsPerSample = 8;
+    params.components = 3;
+    params.interleaveMode = InterleaveMode::Sample;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    vector<uint8_t> expected(color.size() + 1024);
+    size_t bytesWritten{};
+    error_code error = JpegLsEncode(expected.data(), expected.size(), &bytesWritten, color.data(), color.size(), &params, nullptr);
+    Assert::IsTrue(!error);
+    expected.resize(bytesWritten);
+
+    const char* rawPath = "test/file_api_pixels.tmp";
+    const char* encodedPath = "test/file_api_encoded.tmp";
+    const char* decodedPath = "test/file_api_decoded.tmp";
+    FILE* file = fopen(rawPath, "wb");
+    Assert::IsTrue(file != nullptr);
+    Assert::IsTrue(fwrite(color.data(), 1, color.size(), file) == color.size());
+    fclose(file);
+
+    charls_jpegls_encoder* encoder = charls_jpegls_encoder_create();
+    Assert::IsTrue(encoder != nullptr);
+    error = charls_jpegls_encoder_encode_file(encoder, rawPath, encodedPath, &params, &bytesWritten);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(bytesWritten == expected.size());
+    Assert::IsTrue(ReadFile(encodedPath) == expected);
+
+    // A destination file with incomplete encoded data is removed when the encoding fails.
+    const char* failedPath = "test/file_api_failed.tmp";
+    JlsParameters invalidParams{params};
+    invalidParams.width = 0;
+    error = charls_jpegls_encoder_encode_file(encoder, rawPath, failedPath, &invalidParams, &bytesWritten);
+    Assert::IsTrue(error == jpegls_errc::invalid_argument_width);
+    file = fopen(failedPath, "rb");
+    Assert::IsTrue(file == nullptr);
+    charls_jpegls_encoder_destroy(encoder);
+
+    charls_jpegls_decoder* decoder = charls_jpegls_decoder_create();
+    Assert::IsTrue(decoder != nullptr);
+    vector<uint8_t> decoded(color.size());
+    error = charls_jpegls_decoder_decode_file(decoder, encodedPath, decoded.data(), decoded.size(), nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(decoded == color);
+
+    error = charls_jpegls_decoder_decode_file_to_file(decoder, encodedPath, decodedPath, nullptr);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(ReadFile(decodedPath) == color);
+
+    // The destination file has no padding between the rows, the stride of the parameters is not used.
+    JlsParameters lenaParams{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &lenaParams);
+    vector<uint8_t> lena(static_cast<size_t>(lenaParams.width) * lenaParams.height);
+    error = JpegLsDecode(lena.data(), lena.size(), encodedLena.data(), encodedLena.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+    JlsParameters strideParams{};
+    strideParams.stride = lenaParams.width + 10;
+    error = charls_jpegls_decoder_decode_file_to_file(decoder, "test/lena8b.jls", decodedPath, &strideParams);
+    Assert::IsTrue(!error);
+    Assert::IsTrue(ReadFile(decodedPath) == lena);
+
+    error = charls_jpegls_decoder_decode_file(decoder, "test/file_api_missing.tmp", decoded.data(), decoded.size(), nullptr);
+    Assert::IsTrue(error == jpegls_errc::invalid_argument_source);
+    error = charls_jpegls_decoder_decode_file(decoder, rawPath, decoded.data(), decoded.size(), nullptr);
+    Assert::IsTrue(error == jpegls_errc::jpeg_marker_start_byte_not_found);
+
+    // A destination file with incomplete pixels is removed when the decoding fails.
+    file = fopen(encodedPath, "wb");
+    Assert::IsTrue(file != nullptr);
+    Assert::IsTrue(fwrite(expected.data(), 1, expected.size() / 2, file) == expected.size() / 2);
+    fclose(file);
+    error = charls_jpegls_decoder_decode_file_to_file(decoder, encodedPath, decodedPath, nullptr);
+    Assert::IsTrue(static_cast<bool>(error));
+    file = fopen(decodedPath, "rb");
+    Assert::IsTrue(file == nullptr);
+    charls_jpegls_decoder_destroy(decoder);
+
+    remove(rawPath);
+    remove(encodedPath);
+    remove(decodedPath);
+}
+
+
+void TestDecodeTopBand()
+{
+    JlsParameters params{};
+    vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &params);
+    vector<uint8_t> lena(static_cast<size_t>(params.width) * params.height);
+    error_code error = JpegLsDecode(lena.data(), lena.size(), encodedLena.data(), encodedLena.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+
+    // The lines below the rectangle are not decoded: damaged encoded data at the end of the scan doesn't matter.
+    for (size_t i = encodedLena.size() - 200; i < encodedLena.size() - 2; ++i)
+    {
+        encodedLena[i] = 0;
+    }
+
+    for (const JlsRect& rect : {JlsRect{0, 0, 512, 64}, JlsRect{0, 100, 512, 50}, JlsRect{10, 0, 300, 1}})
+    {
+        vector<uint8_t> band(static_cast<size_t>(rect.Width) * rect.Height + 1, 0x1f);
+        error = JpegLsDecodeRect(band.data(), band.size() - 1, encodedLena.data(), encodedLena.size(), rect, nullptr, nullptr);
+        Assert::IsTrue(!error);
+
+        for (int32_t row = 0; row < rect.Height; ++row)
+        {
+            const uint8_t* expected = &lena[static_cast<size_t>(rect.Y + row) * params.width + rect.X];
+            Assert::IsTrue(std::equal(expected, expected + rect.Width, &band[static_cast<size_t>(row) * rect.Width]));
+        }
+        Assert::IsTrue(band.back() == 0x1f);
+    }
+
+    // Each scan of an image with components that are not interleaved is skipped after the band.
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+    vector<uint8_t> planes(color.size());
+    for (size_t pixel = 0; pixel < planes.size() / 3; ++pixel)
+    {
+        for (size_t component = 0; component < 3; ++component)
+        {
+            planes[component * (planes.size() / 3) + pixel] = color[pixel * 3 + component];
+        }
+    }
+
+    for (const int32_t restartInterval : {0, 8})
+    {
+        colorParams.restartInterval = restartInterval;
+        vector<uint8_t> encoded(color.size() + 1024);
+        size_t bytesWritten{};
+        error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, planes.data(), planes.size(), &colorParams, nullptr);
+        Assert::IsTrue(!error);
+        encoded.resize(bytesWritten);
+
+        for (const int32_t threadCount : {1, 2})
+        {
+            JlsParameters decodeParams{};
+            decodeParams.threadCount = threadCount;
+            const JlsRect rect{0, 0, 256, 20};
+            vector<uint8_t> band(static_cast<size_t>(rect.Width) * rect.Height * 3);
+            error = JpegLsDecodeRect(band.data(), band.size(), encoded.data(), encoded.size(), rect, &decodeParams, nullptr);
+            Assert::IsTrue(!error);
+
+            for (size_t component = 0; component < 3; ++component)
+            {
+                const auto expected = planes.begin() + static_cast<std::ptrdiff_t>(component * (planes.size() / 3));
+                Assert::IsTrue(std::equal(expected, expected + rect.Width * rect.Height, band.begin() + static_cast<std::ptrdiff_t>(component * rect.Width * rect.Height)));
+            }
+        }
+    }
+}
+
+
+void TestSampleInterleavedQuads()
+{
+    JlsParameters rgbaParams{};
+    rgbaParams.width = 380;
+    rgbaParams.height = 287;
+    rgbaParams.bitsPerSample = 8;
+    rgbaParams.components = 4;
+    rgbaParams.interleaveMode = InterleaveMode::Sample;
+    const vector<uint8_t> rgba = ReadFile("test/alphatest.raw");
+
+    JlsParameters cmykParams = rgbaParams;
+    cmykParams.width = 100;
+    cmykParams.height = 60;
+    cmykParams.bitsPerSample = 12;
+    const vector<uint8_t> cmyk = MakeSomeNoise16bit(static_cast<size_t>(cmykParams.width) * cmykParams.height * 4, cmykParams.bitsPerSample, 21344);
+
+    struct Image
+    {
+        const vector<uint8_t>& pixels;
+        JlsParameters params;
+    };
+    vector<Image> images{{rgba, rgbaParams}, {rgba, rgbaParams}, {rgba, rgbaParams}, {cmyk, cmykParams}, {cmyk, cmykParams}};
+    images[1].params.allowedLossyError = 2;
+    images[2].params.colorTransformation = charls::ColorTransformation::HP1;
+    images[4].params.allowedLossyError = 3;
+
+    for (const Image& image : images)
+    {
+        vector<uint8_t> encoded(image.pixels.size() * 2 + 1024);
+        size_t bytesWritten{};
+        error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, image.pixels.data(), image.pixels.size(), &image.params, nullptr);
+        Assert::IsTrue(!error);
+
+        JlsParameters params{};
+        error = JpegLsReadHeader(encoded.data(), bytesWritten, &params, nullptr);
+        Assert::IsTrue(!error);
+        Assert::IsTrue(params.components == 4 && params.interleaveMode == InterleaveMode::Sample);
+
+        vector<uint8_t> decoded(image.pixels.size());
+        error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), bytesWritten, nullptr, nullptr);
+        Assert::IsTrue(!error);
+
+        const size_t bytesPerSample = image.params.bitsPerSample > 8 ? 2 : 1;
+        for (size_t i = 0; i < decoded.size(); i += bytesPerSample)
+        {
+            const int expected = bytesPerSample == 2 ? image.pixels[i] | image.pixels[i + 1] << 8 : image.pixels[i];
+            const int actual = bytesPerSample == 2 ? decoded[i] | decoded[i + 1] << 8 : decoded[i];
+            Assert::IsTrue(std::abs(actual - expected) <= image.params.allowedLossyError);
+        }
+    }
+}
+
+
+// Counts the bulk writes to the stream, the encoded bytes are collected in a string.
+class CountingStringBuffer final : public std::stringbuf
+{
+public:
+    int WriteCount() const noexcept
+    {
+        return writeCount_;
+    }
+
+protected:
+    std::streamsize xsputn(const char* bytes, std::streamsize count) override
+    {
+        ++writeCount_;
+        return std::stringbuf::xsputn(bytes, count);
+    }
+
+private:
+    int writeCount_{};
+};
+
+
+void TestOutputBufferSize()
+{
+    JlsParameters params{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &params);
+    vector<uint8_t> lena(static_cast<size_t>(params.width) * params.height);
+    error_code error = JpegLsDecode(lena.data(), lena.size(), encodedLena.data(), encodedLena.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+    params.stride = 0;
+    params.restartInterval = 100;
+
+    vector<uint8_t> expected(lena.size() + 1024);
+    size_t bytesWritten{};
+    error = JpegLsEncode(expected.data(), expected.size(), &bytesWritten, lena.data(), lena.size(), &params, nullptr);
+    Assert::IsTrue(!error);
+    expected.resize(bytesWritten);
+
+    // Every buffer size gives the same encoded bytes, buffers smaller than a restart marker included.
+    for (const int32_t outputBufferSize : {0, 1, 100, 4096})
+    {
+        params.outputBufferSize = outputBufferSize;
+        CountingStringBuffer destination;
+        error = JpegLsEncodeStream({&destination, nullptr, 0}, bytesWritten, FromByteArrayConst(lena.data(), lena.size()), params);
+        Assert::IsTrue(!error);
+
+        const string encoded = destination.str();
+        Assert::IsTrue(encoded == string(expected.cbegin(), expected.cend()));
+
+        // With the default buffer the header and the encoded data of the scan are written with a single call each.
+        if (outputBufferSize == 0)
+        {
+            Assert::IsTrue(destination.WriteCount() <= 2);
+        }
+    }
+}
+
+
+// A decode or encode call on a session reuses the codec and its buffers of the previous call: it should not allocate.
+void TestSessionAllocations()
+{
+    JlsParameters lenaParams{};
+    const vector<uint8_t> encodedLena = ScanFile("test/lena8b.jls", &lenaParams);
+    vector<uint8_t> lena(static_cast<size_t>(lenaParams.width) * lenaParams.height);
+    error_code error = JpegLsDecode(lena.data(), lena.size(), encodedLena.data(), encodedLena.size(), nullptr, nullptr);
+    Assert::IsTrue(!error);
+    lenaParams.stride = 0;
+
+    JlsParameters colorParams{};
+    colorParams.width = 256;
+    colorParams.height = 256;
+    colorParams.bitsPerSample = 8;
+    colorParams.components = 3;
+    const vector<uint8_t> color = ReadFile("test/conformance/TEST8.PPM", 15);
+
+    struct Image
+    {
+        const vector<uint8_t>& pixels;
+        JlsParameters params;
+    };
+    vector<Image> images{{lena, lenaParams}, {color, colorParams}, {color, colorParams}};
+    images[2].params.interleaveMode = InterleaveMode::Line;
+
+    charls_jpegls_encoder* encoder = charls_jpegls_encoder_create();
+    charls_jpegls_decoder* decoder = charls_jpegls_decoder_create();
+    Assert::IsTrue(encoder && decoder);
+
+    for (const Image& image : images)
+    {
+        vector<uint8_t> encoded(image.pixels.size() * 2 + 1024);
+        vector<uint8_t> decoded(image.pixels.size());
+
+        // The first calls create the codecs, the second calls should reuse them.
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            const size_t allocationCountBefore = GetAllocationCount();
+
+            size_t bytesWritten{};
+            error = charls_jpegls_encoder_encode(encoder, encoded.data(), encoded.size(), &bytesWritten, image.pixels.data(), image.pixels.size(), &image.params);
+            Assert::IsTrue(!error);
+
+            error = charls_jpegls_decoder_decode(decoder, decoded.data(), decoded.size(), encoded.data(), bytesWritten, nullptr);
+            Assert::IsTrue(!error);
+
+            if (pass == 1)
+            {
+                Assert::IsTrue(GetAllocationCount() == allocationCountBefore);
+            }
+        }
+        Assert::IsTrue(decoded == image.pixels);
+    }
+
+    charls_jpegls_decoder_destroy(decoder);
+    charls_jpegls_encoder_destroy(encoder);
+
+    // One-shot calls without a session reuse the quantization table of the previous call (128 KiB for 16 bit samples).
+    JlsParameters noiseParams{};
+    noiseParams.width = 16;
+    noiseParams.height = 16;
+    noiseParams.bitsPerSample = 16;
+    noiseParams.components = 1;
+    noiseParams.allowedLossyError = 3;
+    const vector<uint8_t> noise = MakeSomeNoise16bit(static_cast<size_t>(noiseParams.width) * noiseParams.height, noiseParams.bitsPerSample, 21344);
+    vector<uint8_t> encodedNoise(noise.size() * 2 + 1024);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const size_t allocatedByteCountBefore = GetAllocatedByteCount();
+
+        size_t bytesWritten{};
+        error = JpegLsEncode(encodedNoise.data(), encodedNoise.size(), &bytesWritten, noise.data(), noise.size(), &noiseParams, nullptr);
+        Assert::IsTrue(!error);
+
+        if (pass == 1)
+        {
+            Assert::IsTrue(GetAllocatedByteCount() - allocatedByteCountBefore < 64 * 1024);
+        }
+    }
+}
+
+
+template<typename Transform, typename SampleType>
+void TestColorTransformLines(Transform transform, SampleType maximumValue)
+{
+    // 83 pixels: a first pixel, blocks and a tail of pixels that are transformed one by one.
+    const int pixelCount = 83;
+    vector<SampleType> source(pixelCount * 3);
+    uint32_t seed = 1;
+    for (auto& sample : source)
+    {
+        seed = seed * 1103515245 + 12345;
+        sample = static_cast<SampleType>((seed >> 16) % (maximumValue + 1U));
+    }
+
+    typename Transform::Inverse inverse(transform);
+    vector<SampleType> expected(source.size());
+    vector<SampleType> actual(source.size());
+    charls::TransformLine(expected.data(), source.data(), pixelCount, transform, std::false_type{});
+    charls::TransformLine(actual.data(), source.data(), pixelCount, transform, std::true_type{});
+    Assert::IsTrue(expected == actual);
+    charls::TransformLine(expected.data(), source.data(), pixelCount, inverse, std::false_type{});
+    charls::TransformLine(actual.data(), source.data(), pixelCount, inverse, std::true_type{});
+    Assert::IsTrue(expected == actual);
+
+    // The line interleaved transforms use the source as 3 component planes.
+    const auto* triplets = reinterpret_cast<const Triplet<SampleType>*>(source.data());
+    charls::TransformTripletToLine(triplets, pixelCount, expected.data(), pixelCount, transform, std::false_type{});
+    charls::TransformTripletToLine(triplets, pixelCount, actual.data(), pixelCount, transform, std::true_type{});
+    Assert::IsTrue(expected == actual);
+    charls::TransformLineToTriplet(source.data(), pixelCount, reinterpret_cast<Triplet<SampleType>*>(expected.data()), pixelCount, inverse, std::false_type{});
+    charls::TransformLineToTriplet(source.data(), pixelCount, reinterpret_cast<Triplet<SampleType>*>(actual.data()), pixelCount, inverse, std::true_type{});
+    Assert::IsTrue(expected == actual);
+}
+
+
+void TestColorTransforms()
+{
+    TestColorTransformLines(charls::TransformHp1<uint8_t>(), uint8_t{255});
+    TestColorTransformLines(charls::TransformHp2<uint8_t>(), uint8_t{255});
+    TestColorTransformLines(charls::TransformHp3<uint8_t>(), uint8_t{255});
+    TestColorTransformLines(charls::TransformHp1<uint16_t>(), uint16_t{65535});
+    TestColorTransformLines(charls::TransformHp2<uint16_t>(), uint16_t{65535});
+    TestColorTransformLines(charls::TransformHp3<uint16_t>(), uint16_t{65535});
+    TestColorTransformLines(charls::TransformShifted<charls::TransformHp3<uint16_t>>(4), uint16_t{4095});
+
+    // Images with a color transform should decode to the original pixels for all bit depths and interleave modes.
+    for (const int bitsPerSample : {8, 12, 16})
+    {
+        for (const auto colorTransformation : {charls::ColorTransformation::HP1, charls::ColorTransformation::HP2, charls::ColorTransformation::HP3})
+        {
+            // Note: HP2 and HP3 are not reversible for bit depths that need TransformShifted.
+            if (bitsPerSample == 12 && colorTransformation != charls::ColorTransformation::HP1)
+                continue;
+
+            for (const auto interleaveMode : {InterleaveMode::Line, InterleaveMode::Sample})
+            {
+                JlsParameters params{};
+                params.width = 83;
+                params.height = 7;
+                params.bitsPerSample = bitsPerSample;
+                params.components = 3;
+                params.interleaveMode = interleaveMode;
+                params.colorTransformation = colorTransformation;
+
+                const int bytesPerSample = bitsPerSample > 8 ? 2 : 1;
+                vector<uint8_t> pixels(static_cast<size_t>(params.width) * params.height * params.components * bytesPerSample);
+                uint32_t seed = 1;
+                for (size_t i = 0; i < pixels.size(); i += bytesPerSample)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    const uint32_t sample = (seed >> 16) & ((1U << bitsPerSample) - 1);
+                    pixels[i] = static_cast<uint8_t>(sample);
+                    if (bytesPerSample == 2)
+                    {
+                        pixels[i + 1] = static_cast<uint8_t>(sample >> 8);
+                    }
+                }
+
+                vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+                size_t bytesWritten{};
+                error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, pixels.data(), pixels.size(), &params, nullptr);
+                Assert::IsTrue(!error);
+
+                vector<uint8_t> decoded(pixels.size());
+                error = JpegLsDecode(decoded.data(), decoded.size(), encoded.data(), bytesWritten, nullptr, nullptr);
+                Assert::IsTrue(!error);
+                Assert::IsTrue(decoded == pixels);
+            }
+        }
+    }
+}
+
+
 void TestEncodeFromStream(const char* file, int offset, int width, int height, int bpp, int componentCount, InterleaveMode ilv, size_t expectedLength)
 {
     basic_filebuf<char> myFile; // On the stack
@@ -597,6 +1846,51 @@ void UnitTest()
 
         TestDecodeRect();
 
+        cout << "Test restart interval\n";
+        TestRestartInterval();
+
+        cout << "Test decode components concurrently\n";
+        TestDecodeComponentsConcurrently();
+
+        cout << "Test encode components concurrently\n";
+        TestEncodeComponentsConcurrently();
+
+        cout << "Test decode into destination rows\n";
+        TestDecodeIntoDestinationRows();
+
+        cout << "Test codec sessions\n";
+        TestCodecSessions();
+
+        cout << "Test session allocations\n";
+        TestSessionAllocations();
+
+        cout << "Test decode batch\n";
+        TestDecodeBatch();
+
+        cout << "Test push decoder\n";
+        TestPushDecoder();
+
+        cout << "Test line sink\n";
+        TestLineSink();
+
+        cout << "Test encode rows\n";
+        TestEncodeRows();
+
+        cout << "Test encode and decode files\n";
+        TestEncodeDecodeFile();
+
+        cout << "Test decode top band\n";
+        TestDecodeTopBand();
+
+        cout << "Test sample interleaved quads\n";
+        TestSampleInterleavedQuads();
+
+        cout << "Test output buffer size\n";
+        TestOutputBufferSize();
+
+        cout << "Test color transforms\n";
+        TestColorTransforms();
+
         cout << "Test Traits\n";
         TestTraits16bit();
         TestTraits8bit();
@@ -637,7 +1931,7 @@ int main(const int argc, const char * const argv[])
 {
     if (argc == 1)
     {
-        cout << "CharLS test runner.\nOptions: -unittest, -bitstreamdamage, -performance[:loop-count], -decodeperformance[:loop-count], -dontwait -decoderaw -encodepnm -decodetopnm -comparepnm\n";
+        cout << "CharLS test runner.\nOptions: -unittest, -bitstreamdamage, -performance[:loop-count], -decodeperformance[:loop-count], -restartperformance[:loop-count], -losslessperformance[:loop-count], -dontwait -decoderaw -encodepnm -decodetopnm -comparepnm\n";
         return EXIT_FAILURE;
     }
 
@@ -753,6 +2047,46 @@ int main(const int argc, const char * const argv[])
             continue;
         }
 
+        if (str.compare(0, 19, "-restartperformance") == 0)
+        {
+            int loopCount = 1;
+
+            // Extract the optional loop count from the command line. Longer running tests make the measurements more reliable.
+            auto index = str.find(':');
+            if (index != string::npos)
+            {
+                loopCount = stoi(str.substr(++index));
+                if (loopCount < 1)
+                {
+                    cout << "Loop count not understood or invalid: " << str << "\n";
+                    break;
+                }
+            }
+
+            RestartIntervalPerformanceTests(loopCount);
+            continue;
+        }
+
+        if (str.compare(0, 20, "-losslessperformance") == 0)
+        {
+            int loopCount = 1;
+
+            // Extract the optional loop count from the command line. Longer running tests make the measurements more reliable.
+            auto index = str.find(':');
+            if (index != string::npos)
+            {
+                loopCount = stoi(str.substr(++index));
+                if (loopCount < 1)
+                {
+                    cout << "Loop count not understood or invalid: " << str << "\n";
+                    break;
+                }
+            }
+
+            LosslessPerformanceTests(loopCount);
+            continue;
+        }
+
         if (str == "-dicom")
         {
             TestDicomWG4Images();
@@ -3,9 +3,12 @@
 #include "performance.h"
 #include "util.h"
 
+#include <algorithm>
 #include <vector>
 #include <ratio>
 #include <chrono>
+#include <iomanip>
+#include <thread>
 
 using std::vector;
 using std::cout;
@@ -14,6 +17,9 @@ using std::istream;
 using std::chrono::steady_clock;
 using std::chrono::duration;
 using std::milli;
+using std::setw;
+using std::setprecision;
+using charls::InterleaveMode;
 
 namespace
 {
@@ -64,6 +70,126 @@ void TestPerformance(int loopCount)
 }
 
 
+double EncodeTime(const vector<uint8_t>& source, vector<uint8_t>& encoded, size_t& bytesWritten, const JlsParameters& params, int loopCount)
+{
+    const auto start = steady_clock::now();
+    for (int i = 0; i < loopCount; ++i)
+    {
+        const error_code error = JpegLsEncode(encoded.data(), encoded.size(), &bytesWritten, source.data(), source.size(), &params, nullptr);
+        Assert::IsTrue(!error);
+    }
+
+    return duration<double, milli>(steady_clock::now() - start).count() / loopCount;
+}
+
+
+void TestRestartIntervalCost(const char* filename, int offset, Size size, int loopCount)
+{
+    const vector<uint8_t> source = ReadFile(filename, offset);
+    vector<uint8_t> encoded(source.size() * 2 + 1024);
+
+    JlsParameters params{};
+    params.width = static_cast<int>(size.cx);
+    params.height = static_cast<int>(size.cy);
+    params.bitsPerSample = 8;
+    params.components = 1;
+
+    size_t baseSize{};
+    const double baseTime = EncodeTime(source, encoded, baseSize, params, loopCount);
+    cout << filename << ": " << baseSize << " bytes, encode time: " << setprecision(3) << baseTime << " ms without restart intervals\n";
+
+    const int threadCount = std::max(static_cast<int>(std::thread::hardware_concurrency()), 2);
+    for (const int restartInterval : {512, 256, 128, 64, 32, 16, 8})
+    {
+        if (restartInterval >= params.height)
+            continue;
+
+        params.restartInterval = restartInterval;
+        params.threadCount = 1;
+        size_t bytesWritten{};
+        const double encodeTime = EncodeTime(source, encoded, bytesWritten, params, loopCount);
+
+        params.threadCount = threadCount;
+        const double concurrentEncodeTime = EncodeTime(source, encoded, bytesWritten, params, loopCount);
+
+        const double cost = 100.0 * (static_cast<double>(bytesWritten) - baseSize) / baseSize;
+        cout << "Restart interval:" << setw(4) << restartInterval << ", size: " << bytesWritten << " bytes (+" << cost <<
+            "%), encode time: " << encodeTime << " ms, with " << threadCount << " threads: " << concurrentEncodeTime << " ms\n";
+    }
+}
+
+
+double DecodeTime(const vector<uint8_t>& encoded, size_t encodedSize, vector<uint8_t>& destination, int loopCount)
+{
+    const auto start = steady_clock::now();
+    for (int i = 0; i < loopCount; ++i)
+    {
+        const error_code error = JpegLsDecode(destination.data(), destination.size(), encoded.data(), encodedSize, nullptr, nullptr);
+        Assert::IsTrue(!error);
+    }
+
+    return duration<double, milli>(steady_clock::now() - start).count() / loopCount;
+}
+
+
+// Scales 8 bit samples to the bit count: the image keeps its structure at every bit depth.
+vector<uint8_t> ScaleSamples(const vector<uint8_t>& source, int bitCount)
+{
+    if (bitCount <= 8)
+    {
+        vector<uint8_t> scaled(source.size());
+        std::transform(source.begin(), source.end(), scaled.begin(), [bitCount](uint8_t value) { return static_cast<uint8_t>(value >> (8 - bitCount)); });
+        return scaled;
+    }
+
+    vector<uint8_t> scaled(source.size() * 2);
+    for (size_t i = 0; i < source.size(); ++i)
+    {
+        const auto value = static_cast<uint16_t>(source[i] << (bitCount - 8) | source[i] >> (16 - bitCount));
+        scaled[i * 2] = static_cast<uint8_t>(value);
+        scaled[i * 2 + 1] = static_cast<uint8_t>(value >> 8);
+    }
+    return scaled;
+}
+
+
+// Compares the lossless codec of which the sample range is a compile time constant with the codec with run time traits,
+// which is used when the coding parameters have a custom RESET value.
+void TestLosslessBitDepths(const char* filename, int offset, Size size, int componentCount, int loopCount)
+{
+    const vector<uint8_t> source = ReadFile(filename, offset);
+    cout << filename << ", " << componentCount << (componentCount == 1 ? " component\n" : " components, sample interleaved\n");
+
+    for (int bitCount = 2; bitCount <= 16; ++bitCount)
+    {
+        const vector<uint8_t> pixels = ScaleSamples(source, bitCount);
+        vector<uint8_t> encoded(pixels.size() * 2 + 1024);
+        vector<uint8_t> decoded(pixels.size());
+
+        JlsParameters params{};
+        params.width = static_cast<int>(size.cx);
+        params.height = static_cast<int>(size.cy);
+        params.bitsPerSample = bitCount;
+        params.components = componentCount;
+        params.interleaveMode = componentCount == 1 ? InterleaveMode::None : InterleaveMode::Sample;
+
+        size_t bytesWritten{};
+        const double encodeTime = EncodeTime(pixels, encoded, bytesWritten, params, loopCount);
+        const double decodeTime = DecodeTime(encoded, bytesWritten, decoded, loopCount);
+        Assert::IsTrue(decoded == pixels);
+
+        params.custom.MaximumSampleValue = (1 << bitCount) - 1;
+        params.custom.ResetValue = 63;
+        const double runTimeTraitsEncodeTime = EncodeTime(pixels, encoded, bytesWritten, params, loopCount);
+        const double runTimeTraitsDecodeTime = DecodeTime(encoded, bytesWritten, decoded, loopCount);
+        Assert::IsTrue(decoded == pixels);
+
+        cout << "Bits per sample:" << setw(3) << bitCount << setprecision(3) <<
+            ", encode time: " << setw(6) << encodeTime << " ms (run time traits: " << setw(6) << runTimeTraitsEncodeTime <<
+            " ms), decode time: " << setw(6) << decodeTime << " ms (run time traits: " << setw(6) << runTimeTraitsDecodeTime << " ms)\n";
+    }
+}
+
 } // namespace
 
 
@@ -109,6 +235,32 @@ void TestLargeImagePerformanceRgb8(int loopCount)
     }
 }
 
+void RestartIntervalPerformanceTests(int loopCount)
+{
+#ifdef _DEBUG
+    cout << "NOTE: running performance test in debug mode, performance may be slow!\n";
+#endif
+    // Every restart interval resets the context state of the codec, which costs compression ratio. The report shows this
+    // cost next to the encode time with 1 and more threads, to help with selecting the restart interval (band size).
+    cout << "Test restart interval cost (with loop count " << loopCount << ")\n";
+
+    TestRestartIntervalCost("test/0015.raw", 0, Size(1024, 1024), loopCount);
+    TestRestartIntervalCost("test/lena8b.raw", 0, Size(512, 512), loopCount);
+}
+
+
+void LosslessPerformanceTests(int loopCount)
+{
+#ifdef _DEBUG
+    cout << "NOTE: running performance test in debug mode, performance may be slow!\n";
+#endif
+    cout << "Test lossless performance per bit depth (with loop count " << loopCount << ")\n";
+
+    TestLosslessBitDepths("test/lena8b.raw", 0, Size(512, 512), 1, loopCount);
+    TestLosslessBitDepths("test/desktop.ppm", 40, Size(1280, 1024), 3, loopCount);
+}
+
+
 void DecodePerformanceTests(int loopCount)
 {
     cout << "Test decode Perf (with loop count " << loopCount << ")\n";
@@ -4,4 +4,6 @@
 
 void PerformanceTests(int loopCount);
 void DecodePerformanceTests(int loopCount);
+void RestartIntervalPerformanceTests(int loopCount);
+void LosslessPerformanceTests(int loopCount);
 void TestLargeImagePerformanceRgb8(int loopCount);
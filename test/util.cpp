@@ -8,6 +8,9 @@
 #include <vector>
 #include <iomanip>
 #include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
 
 using std::cout;
 using std::cerr;
@@ -122,7 +125,7 @@ void TestRoundTrip(const char* strName, const vector<uint8_t>& originalBuffer, J
 
     if (params.components == 4)
     {
-        params.interleaveMode = InterleaveMode::Line;
+        params.interleaveMode = InterleaveMode::Sample;
     }
     else if (params.components == 3)
     {
@@ -193,3 +196,58 @@ void test_portable_anymap_file(const char* filename, int loopCount)
     TestRoundTrip(filename, anymapFile.image_data(), Size(anymapFile.width(), anymapFile.height()),
         anymapFile.bits_per_sample(), anymapFile.component_count(), loopCount);
 }
+
+
+// The global operator new and delete are replaced to count the allocations. They are defined in this file, apart from
+// the tests, so that the compiler doesn't inline them into the callers.
+namespace
+{
+
+std::atomic<size_t> allocationCount{};
+std::atomic<size_t> allocatedByteCount{};
+
+} // namespace
+
+
+void* operator new(size_t size)
+{
+    ++allocationCount;
+    allocatedByteCount += size;
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (!memory)
+        throw std::bad_alloc();
+
+    return memory;
+}
+
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    ++allocationCount;
+    allocatedByteCount += size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+
+size_t GetAllocationCount() noexcept
+{
+    return allocationCount;
+}
+
+
+size_t GetAllocatedByteCount() noexcept
+{
+    return allocatedByteCount;
+}
@@ -26,6 +26,12 @@ void TestRoundTrip(const char* strName, const std::vector<uint8_t>& originalBuff
 void WriteFile(const char* filename, std::vector<uint8_t>& buffer);
 void test_portable_anymap_file(const char* filename, int loopCount = 1);
 
+// Returns the number of heap allocations (operator new) of the test program, the library included.
+size_t GetAllocationCount() noexcept;
+
+// Returns the number of bytes requested from operator new by the test program, the library included.
+size_t GetAllocatedByteCount() noexcept;
+
 class UnitTestException : public std::exception {
 public:
     explicit UnitTestException() = default;
@@ -245,5 +245,51 @@ namespace CharLSUnitTest
             Assert::AreEqual(static_cast<uint8_t>(0), buffer[8]); // ILV parameter.
             Assert::AreEqual(static_cast<uint8_t>(0), buffer[9]); // transformation.
         }
+
+        TEST_METHOD(WriteDefineRestartIntervalSegment)
+        {
+            array<uint8_t, 6> buffer{};
+            const ByteStreamInfo info = FromByteArray(buffer.data(), buffer.size());
+            JpegStreamWriter writer(info);
+
+            writer.WriteDefineRestartIntervalSegment(0x1234);
+
+            Assert::AreEqual(buffer.size(), writer.GetBytesWritten());
+            Assert::AreEqual(static_cast<uint8_t>(0xFF), buffer[0]);
+            Assert::AreEqual(static_cast<uint8_t>(JpegMarkerCode::DefineRestartInterval), buffer[1]);
+            Assert::AreEqual(static_cast<uint8_t>(0), buffer[2]);
+            Assert::AreEqual(static_cast<uint8_t>(4), buffer[3]);
+            Assert::AreEqual(static_cast<uint8_t>(0x12), buffer[4]); // Ri = restart interval.
+            Assert::AreEqual(static_cast<uint8_t>(0x34), buffer[5]);
+        }
+
+        TEST_METHOD(WriteEncodedData)
+        {
+            const array<uint8_t, 3> data{0x12, 0xFF, 0x34};
+            array<uint8_t, 5> buffer{};
+            const ByteStreamInfo info = FromByteArray(buffer.data(), buffer.size());
+            JpegStreamWriter writer(info);
+
+            writer.WriteStartOfImage();
+            writer.WriteEncodedData(data.data(), data.size());
+
+            Assert::AreEqual(buffer.size(), writer.GetBytesWritten());
+            Assert::AreEqual(static_cast<uint8_t>(0x12), buffer[2]);
+            Assert::AreEqual(static_cast<uint8_t>(0xFF), buffer[3]);
+            Assert::AreEqual(static_cast<uint8_t>(0x34), buffer[4]);
+        }
+
+        TEST_METHOD(WriteRestartMarker)
+        {
+            array<uint8_t, 2> buffer{};
+            const ByteStreamInfo info = FromByteArray(buffer.data(), buffer.size());
+            JpegStreamWriter writer(info);
+
+            writer.WriteRestartMarker(7);
+
+            Assert::AreEqual(buffer.size(), writer.GetBytesWritten());
+            Assert::AreEqual(static_cast<uint8_t>(0xFF), buffer[0]);
+            Assert::AreEqual(static_cast<uint8_t>(0xD7), buffer[1]);
+        }
     };
 }